@@ -0,0 +1,66 @@
+#include "Bodies.h"
+#include "ParticleManager.h"
+#include "QuadTree.h"
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+/*
+time of the force pass (tree walk + force evaluation, without the build) against body count
+
+usage: force_bench [threads] [repetitions] [theta] [leaf_capacity]
+*/
+
+int main(int argc, char** argv)
+{
+    const unsigned threads = argc > 1 ? std::stoul(argv[1]) : 0;
+    const unsigned repetitions = argc > 2 ? std::stoul(argv[2]) : 5;
+    const double theta = argc > 3 ? std::stod(argv[3]) : 1.2;
+    const unsigned leaf_capacity = argc > 4 ? std::stoul(argv[4]) : 8;
+    const double G = 6.67408e-3;
+
+    const unsigned width = 2200;
+    const unsigned height = 2200;
+
+    const std::vector<unsigned> body_counts = { 10000, 100000, 1000000 };
+
+    std::shared_ptr<ThreadPool> thread_pool = std::make_shared<ThreadPool>(threads);
+
+    std::cout << std::left << std::setw(12) << "bodies" << std::setw(14) << "force [ms]"
+        << std::setw(18) << "interactions" << "ns/interaction" << std::endl;
+
+    for ( unsigned num_bodies : body_counts )
+    {
+        std::shared_ptr<Bodies> bodies = std::make_shared<Bodies>(num_bodies);
+        ParticleManager particle_manager(bodies, width, height, thread_pool);
+        particle_manager.add_bodies(BodyType::RANDOM, num_bodies, 10.0);
+
+        Vec2 top_left, bottom_right;
+        particle_manager.get_particle_area(top_left, bottom_right);
+
+        QuadTree tree(bodies, thread_pool, top_left, bottom_right);
+        tree.set_leaf_capacity(leaf_capacity);
+        tree.build(top_left, bottom_right);
+
+        unsigned long calculations = 0;
+        tree.update(theta, G, 0.0, calculations); // warm up, also gives the load balancer its costs
+
+        auto start_time = std::chrono::high_resolution_clock::now();
+        for ( unsigned r = 0; r < repetitions; ++r )
+        {
+            tree.update(theta, G, 0.0, calculations);
+        }
+        double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count() / repetitions;
+
+        std::cout << std::left << std::setw(12) << num_bodies
+            << std::setw(14) << std::fixed << std::setprecision(3) << elapsed
+            << std::setw(18) << std::scientific << std::setprecision(3) << static_cast<double>(calculations)
+            << std::fixed << std::setprecision(3) << elapsed * 1e6 / static_cast<double>(calculations) << std::endl;
+    }
+
+    return 0;
+}
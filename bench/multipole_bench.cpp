@@ -0,0 +1,135 @@
+#include "Bodies.h"
+#include "FastMultipole.h"
+#include "ParticleManager.h"
+#include "QuadTree.h"
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+/*
+force error and time of the monopole and the quadrupole force pass against theta,
+followed by the fast multipole method for a few expansion orders (with its own leaf size and opening angle).
+the error is the rms of |a_tree - a_direct| / rms |a_direct| over a sample of bodies, summed directly.
+
+usage: multipole_bench [threads] [bodies] [samples]
+*/
+
+int main(int argc, char** argv)
+{
+    const unsigned threads = argc > 1 ? std::stoul(argv[1]) : 0;
+    const unsigned num_bodies = argc > 2 ? std::stoul(argv[2]) : 100000;
+    const unsigned samples = argc > 3 ? std::stoul(argv[3]) : 500;
+    const unsigned repetitions = 3;
+    const double G = 6.67408e-3;
+
+    const unsigned width = 2200;
+    const unsigned height = 2200;
+
+    const std::vector<double> thetas = { 0.3, 0.5, 0.8, 1.2, 1.5 };
+
+    std::shared_ptr<ThreadPool> thread_pool = std::make_shared<ThreadPool>(threads);
+
+    std::shared_ptr<Bodies> bodies = std::make_shared<Bodies>(num_bodies);
+    ParticleManager particle_manager(bodies, width, height, thread_pool);
+    particle_manager.add_bodies(BodyType::RANDOM, num_bodies, 10.0);
+
+    Vec2 top_left, bottom_right;
+    particle_manager.get_particle_area(top_left, bottom_right);
+
+    // reference accelerations of every stride-th body
+    const unsigned n = bodies->get_size();
+    const unsigned stride = std::max(1u, n / samples);
+
+    std::vector<unsigned> sample_index;
+    std::vector<Vec2> reference;
+    for ( unsigned i = 0; i < n; i += stride )
+    {
+        double acc_x = 0.0, acc_y = 0.0;
+        for ( unsigned j = 0; j < n; ++j )
+        {
+            const double dx = bodies->pos[j].x - bodies->pos[i].x;
+            const double dy = bodies->pos[j].y - bodies->pos[i].y;
+            const double factor = G * bodies->mass[j] / (dx * dx + dy * dy + SOFTENING_SQUARED);
+            acc_x += dx * factor;
+            acc_y += dy * factor;
+        }
+
+        sample_index.push_back(i);
+        reference.push_back(Vec2(acc_x, acc_y));
+    }
+
+    std::cout << n << " bodies, " << sample_index.size() << " samples, " << thread_pool->get_num_threads() << " threads\n\n";
+    std::cout << std::left << std::setw(8) << "theta" << std::setw(12) << "mode" << std::setw(14) << "force [ms]"
+        << std::setw(18) << "interactions" << "rms error" << std::endl;
+
+    auto rms_error = [&bodies, &sample_index, &reference]()
+        {
+            double error = 0.0, norm = 0.0;
+            for ( unsigned s = 0; s < sample_index.size(); ++s )
+            {
+                const Vec2 diff = bodies->acc[sample_index[s]] - reference[s];
+                error += diff.x * diff.x + diff.y * diff.y;
+                norm += reference[s].x * reference[s].x + reference[s].y * reference[s].y;
+            }
+            return std::sqrt(error / norm);
+        };
+
+    std::shared_ptr<QuadTree> tree = std::make_shared<QuadTree>(bodies, thread_pool);
+
+    for ( double theta : thetas )
+    {
+        for ( bool quadrupole : { false, true } )
+        {
+            tree->set_quadrupole(quadrupole);
+            tree->build(top_left, bottom_right);
+
+            unsigned long calculations = 0;
+            tree->update(theta, G, 0.0, calculations); // warm up, also gives the load balancer its costs
+
+            auto start_time = std::chrono::high_resolution_clock::now();
+            for ( unsigned r = 0; r < repetitions; ++r )
+            {
+                tree->update(theta, G, 0.0, calculations);
+            }
+            double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count() / repetitions;
+
+            std::cout << std::left << std::setw(8) << std::fixed << std::setprecision(1) << theta
+                << std::setw(12) << (quadrupole ? "quadrupole" : "monopole")
+                << std::setw(14) << std::setprecision(3) << elapsed
+                << std::setw(18) << std::scientific << std::setprecision(3) << static_cast<double>(calculations)
+                << rms_error() << std::endl;
+        }
+    }
+
+    FastMultipole fast_multipole(tree, thread_pool);
+    tree->set_quadrupole(false);
+    tree->set_leaf_capacity(32);
+    tree->build(top_left, bottom_right);
+
+    for ( unsigned order : { 2u, 4u, 6u, 10u } )
+    {
+        fast_multipole.set_order(order);
+
+        unsigned long calculations = 0;
+        fast_multipole.update(G, 0.0, calculations);
+
+        auto start_time = std::chrono::high_resolution_clock::now();
+        for ( unsigned r = 0; r < repetitions; ++r )
+        {
+            fast_multipole.update(G, 0.0, calculations);
+        }
+        double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count() / repetitions;
+
+        std::cout << std::left << std::setw(8) << std::fixed << std::setprecision(1) << fast_multipole.get_opening_angle()
+            << std::setw(12) << ("fmm p=" + std::to_string(order))
+            << std::setw(14) << std::setprecision(3) << elapsed
+            << std::setw(18) << std::scientific << std::setprecision(3) << static_cast<double>(calculations)
+            << rms_error() << std::endl;
+    }
+
+    return 0;
+}
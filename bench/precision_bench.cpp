@@ -0,0 +1,172 @@
+#include "Bodies.h"
+#include "QuadTree.h"
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+/*
+energy drift of a rotating, centrally concentrated disc, to compare the precision builds and integrators against each other.
+CMake builds this once per precision: precision_bench (double), precision_bench_float (float)
+and precision_bench_float_accumulate (float storage, double force sums and centers of mass).
+the initial conditions are seeded, so every build starts from the same disc.
+
+the force a = G m d / (|d|^2 + eps^2) is the gradient of the (2D, logarithmic) potential
+    U = G * sum_{i<j} m_i m_j ln(|d|^2 + eps^2) / 2
+both energies are summed directly in double, independent of the build. the logarithm has no natural zero,
+so the drift is measured relative to the initial kinetic energy instead of the total energy.
+
+a nonzero integrator argument switches from kick drift kick to velocity verlet,
+time_levels > 0 runs with block timesteps down to dt / 2^time_levels.
+
+usage: precision_bench [threads] [bodies] [steps] [dt] [theta] [integrator] [time_levels]
+*/
+
+static void compute_energies(const Bodies& bodies, double G, double& kinetic, double& potential)
+{
+    const unsigned n = bodies.size;
+
+    kinetic = 0.0;
+    potential = 0.0;
+    for ( unsigned i = 0; i < n; ++i )
+    {
+        const double vx = bodies.vx[i], vy = bodies.vy[i];
+        kinetic += 0.5 * bodies.mass[i] * (vx * vx + vy * vy);
+
+        for ( unsigned j = i + 1; j < n; ++j )
+        {
+            const double dx = static_cast<double>(bodies.x[j]) - bodies.x[i];
+            const double dy = static_cast<double>(bodies.y[j]) - bodies.y[i];
+            potential += 0.5 * static_cast<double>(bodies.mass[i]) * bodies.mass[j] * std::log(dx * dx + dy * dy + SOFTENING_SQUARED);
+        }
+    }
+
+    potential *= G;
+}
+
+int main(int argc, char** argv)
+{
+    const unsigned threads = argc > 1 ? std::stoul(argv[1]) : 0;
+    const unsigned num_bodies = argc > 2 ? std::stoul(argv[2]) : 5000;
+    const unsigned steps = argc > 3 ? std::stoul(argv[3]) : 1000;
+    const double dt = argc > 4 ? std::stod(argv[4]) : 0.1;
+    const double theta = argc > 5 ? std::stod(argv[5]) : 0.5;
+    const bool verlet = argc > 6 && std::stoi(argv[6]) != 0;
+    const unsigned time_levels = argc > 7 ? std::stoul(argv[7]) : 0;
+    const unsigned report_every = std::max(1u, steps / 10);
+    const double G = 6.67408e-3;
+
+    const double center = 1100.0;
+    const double disc_radius = 1000.0;
+    const double body_mass = 10.0;
+
+    std::shared_ptr<ThreadPool> thread_pool = std::make_shared<ThreadPool>(threads);
+    std::shared_ptr<Bodies> bodies = std::make_shared<Bodies>(num_bodies);
+    bodies->integrator = verlet ? VELOCITY_VERLET : LEAPFROG_KDK;
+    bodies->set_max_time_level(time_levels);
+
+    // r = R u^2 puts half of the bodies into the inner quarter, so accelerations (and timesteps) differ a lot.
+    // circular orbits, in 2D the enclosed mass alone gives v^2 = G * M(r) = G * M * sqrt(r / R)
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    for ( unsigned i = 0; i < num_bodies; ++i )
+    {
+        const double u = uniform(gen);
+        const double r = disc_radius * u * u;
+        const double angle = 2.0 * M_PI * uniform(gen);
+        const double speed = std::sqrt(G * body_mass * num_bodies * u);
+
+        bodies->pos[i] = Vec2(center + r * std::cos(angle), center + r * std::sin(angle));
+        bodies->vel[i] = Vec2(-speed * std::sin(angle), speed * std::cos(angle));
+        bodies->mass[i] = body_mass;
+        bodies->radius[i] = 1.0;
+    }
+
+    QuadTree tree(bodies, thread_pool);
+    unsigned long calculations = 0;
+
+    // fills the accelerations, with dt > 0 also the closing kick of the step
+    auto compute_forces = [&](double step_dt)
+        {
+            Vec2 top_left(center, center), bottom_right(center, center);
+            for ( unsigned i = 0; i < bodies->size; ++i )
+            {
+                top_left = Vec2(std::min(top_left.x, bodies->x[i]), std::min(top_left.y, bodies->y[i]));
+                bottom_right = Vec2(std::max(bottom_right.x, bodies->x[i]), std::max(bottom_right.y, bodies->y[i]));
+            }
+
+            tree.build(top_left, bottom_right);
+            tree.update(theta, G, step_dt, calculations);
+        };
+
+    std::cout << num_bodies << " bodies, " << steps << " steps, dt " << dt << ", theta " << theta << ", "
+        << thread_pool->get_num_threads() << " threads\n";
+    std::cout << "storage " << (sizeof(real) == 4 ? "float" : "double")
+        << ", accumulation " << (sizeof(accumulator) == 4 ? "float" : "double")
+        << ", " << (verlet ? "velocity verlet" : "leapfrog kdk") << ", " << time_levels << " time levels\n\n";
+    std::cout << std::left << std::setw(10) << "step" << std::setw(24) << "energy" << "relative drift" << std::endl;
+
+    double initial_kinetic, initial_potential;
+    compute_energies(*bodies, G, initial_kinetic, initial_potential);
+    const double initial_energy = initial_kinetic + initial_potential;
+    std::cout << std::left << std::setw(10) << 0 << std::setw(24) << std::setprecision(15) << initial_energy << 0.0 << std::endl;
+
+    // the forces of the last step are reused for the first half of the next one
+    compute_forces(0.0);
+
+    double max_drift = 0.0;
+    double force_time = 0.0;
+    unsigned long forces = 0;
+    for ( unsigned step = 1; step <= steps; ++step )
+    {
+        // same as SimulationManager::update_simulation, serial
+        const unsigned substeps = bodies->get_substeps();
+        for ( unsigned substep = 0; substep < substeps; )
+        {
+            unsigned stride = substeps;
+            if ( time_levels == 0 )
+            {
+                bodies->begin_step(dt);
+                forces += num_bodies;
+            }
+            else
+            {
+                unsigned deepest_level;
+                bodies->substep = substep;
+                forces += bodies->kick_starting_bodies(dt, 0, num_bodies, deepest_level);
+
+                stride = 1u << (bodies->max_time_level - deepest_level);
+                bodies->drift(stride * dt / substeps, 0, num_bodies);
+            }
+
+            substep += stride;
+            bodies->substep = substep & (substeps - 1);
+
+            auto start_time = std::chrono::high_resolution_clock::now();
+            compute_forces(dt);
+            force_time += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+        }
+
+        if ( step % report_every == 0 || step == steps )
+        {
+            double kinetic, potential;
+            compute_energies(*bodies, G, kinetic, potential);
+            const double energy = kinetic + potential;
+            const double drift = std::abs(energy - initial_energy) / initial_kinetic;
+            max_drift = std::max(max_drift, drift);
+
+            std::cout << std::left << std::setw(10) << step << std::setw(24) << std::setprecision(15) << energy
+                << std::scientific << std::setprecision(3) << drift << std::defaultfloat << std::endl;
+        }
+    }
+
+    std::cout << "\nmax drift " << std::scientific << std::setprecision(3) << max_drift
+        << ", build + force " << std::fixed << std::setprecision(3) << force_time / steps << " ms/step"
+        << ", " << std::setprecision(2) << static_cast<double>(forces) / (static_cast<double>(num_bodies) * steps) << " forces/body/step" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include "FrameExporter.h"
+#include "Rasterizer.h"
+#include "Real.h"
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+time of the software rasterizer for 10^5 to max_bodies bodies in a disc with a dense core,
+optionally writes the image of the largest count as png
+
+usage: raster_bench [threads] [max_bodies] [width] [height] [repetitions] [png]
+*/
+
+int main(int argc, char** argv)
+{
+    const unsigned threads = argc > 1 ? std::stoul(argv[1]) : 0;
+    const unsigned max_bodies = argc > 2 ? std::stoul(argv[2]) : 10000000;
+    const unsigned width = argc > 3 ? std::stoul(argv[3]) : 3840;
+    const unsigned height = argc > 4 ? std::stoul(argv[4]) : 2160;
+    const unsigned repetitions = argc > 5 ? std::stoul(argv[5]) : 10;
+    const std::string png = argc > 6 ? argv[6] : "";
+
+    ThreadPool thread_pool(threads);
+    Rasterizer rasterizer(width, height);
+    rasterizer.set_view(-1.6 * width / height, -1.6, 3.2 * width / height, 3.2);
+
+    // exponential disc around a gaussian core, a few bodies end up outside of the view
+    std::vector<real> x(max_bodies), y(max_bodies);
+    std::mt19937 generator(42);
+    std::exponential_distribution<double> disc(3.0);
+    std::normal_distribution<double> core(0.0, 0.05);
+    std::uniform_real_distribution<double> angle(0.0, 2.0 * M_PI);
+    for ( unsigned i = 0; i < max_bodies; ++i )
+    {
+        const double phi = angle(generator);
+        const double r = i % 4 == 0 ? std::abs(core(generator)) : disc(generator);
+        x[i] = static_cast<real>(r * std::cos(phi));
+        y[i] = static_cast<real>(r * std::sin(phi));
+    }
+
+    std::vector<uint8_t> image(4ul * width * height);
+
+    std::cout << width << " x " << height << ", " << thread_pool.get_num_threads() << " threads\n\n";
+    std::cout << std::left << std::setw(12) << "bodies" << std::setw(14) << "render [ms]"
+        << std::setw(16) << "ns/body" << "highest count" << std::endl;
+
+    std::vector<unsigned> body_counts;
+    for ( unsigned count = 100000; count < max_bodies; count *= 10 )
+    {
+        body_counts.push_back(count);
+    }
+    body_counts.push_back(max_bodies);
+
+    for ( unsigned num_bodies : body_counts )
+    {
+        rasterizer.render(thread_pool, x.data(), y.data(), num_bodies, image.data()); // warm up, the buffers grow here
+
+        auto start_time = std::chrono::high_resolution_clock::now();
+        for ( unsigned r = 0; r < repetitions; ++r )
+        {
+            rasterizer.render(thread_pool, x.data(), y.data(), num_bodies, image.data());
+        }
+        double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count() / repetitions;
+
+        std::cout << std::left << std::setw(12) << num_bodies
+            << std::setw(14) << std::fixed << std::setprecision(3) << elapsed
+            << std::setw(16) << std::setprecision(3) << elapsed * 1e6 / num_bodies
+            << rasterizer.get_highest_count() << std::endl;
+    }
+
+    if ( !png.empty() && !write_png(png, width, height, image.data()) )
+    {
+        std::cerr << "could not write " << png << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
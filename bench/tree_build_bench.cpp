@@ -0,0 +1,75 @@
+#include "Bodies.h"
+#include "ParticleManager.h"
+#include "QuadTree.h"
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+/*
+build time of the morton tree against body count and thread count
+
+usage: tree_build_bench [max_threads] [repetitions]
+*/
+
+int main(int argc, char** argv)
+{
+    const unsigned hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+    const unsigned max_threads = argc > 1 ? std::stoul(argv[1]) : hardware_threads;
+    const unsigned repetitions = argc > 2 ? std::stoul(argv[2]) : 10;
+
+    const unsigned width = 2200;
+    const unsigned height = 2200;
+
+    const std::vector<unsigned> body_counts = { 10000, 100000, 1000000 };
+
+    std::vector<unsigned> thread_counts;
+    for ( unsigned t = 1; t < max_threads; t *= 2 )
+    {
+        thread_counts.push_back(t);
+    }
+    thread_counts.push_back(max_threads);
+
+    std::cout << std::left << std::setw(12) << "bodies" << std::setw(10) << "threads"
+        << std::setw(14) << "build [ms]" << std::setw(12) << "speedup" << "nodes" << std::endl;
+
+    for ( unsigned num_bodies : body_counts )
+    {
+        std::shared_ptr<Bodies> bodies = std::make_shared<Bodies>(num_bodies);
+        ParticleManager particle_manager(bodies, width, height);
+        particle_manager.add_bodies(BodyType::RANDOM, num_bodies, 10.0);
+
+        Vec2 top_left, bottom_right;
+        particle_manager.get_particle_area(top_left, bottom_right);
+
+        double single_thread_time = 0.0;
+
+        for ( unsigned threads : thread_counts )
+        {
+            QuadTree tree(bodies, std::make_shared<ThreadPool>(threads));
+            tree.build(top_left, bottom_right); // warm up, the node arrays reach their final capacity here
+
+            auto start_time = std::chrono::high_resolution_clock::now();
+            for ( unsigned r = 0; r < repetitions; ++r )
+            {
+                tree.build(top_left, bottom_right);
+            }
+            double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count() / repetitions;
+
+            if ( threads == 1 )
+            {
+                single_thread_time = elapsed;
+            }
+
+            std::cout << std::left << std::setw(12) << num_bodies << std::setw(10) << threads
+                << std::setw(14) << std::fixed << std::setprecision(3) << elapsed
+                << std::setw(12) << std::setprecision(2) << single_thread_time / elapsed
+                << tree.get_node_count() << std::endl;
+        }
+    }
+
+    return 0;
+}
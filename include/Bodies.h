@@ -1,41 +1,134 @@
 #ifndef BODIES_H
 #define BODIES_H
 
+#include "AlignedAllocator.h"
 #include "Vec2.h"
+#include "Vec2Array.h"
+
+#include <cmath>
+#include <cstdint>
 #include <iostream>
 #include <vector>
 #include <utility>
 
+// both are second order and symplectic, they only split the step differently
+enum Integrator {
+    LEAPFROG_KDK,       // v += a dt/2, x += v dt | forces | v += a dt/2
+    VELOCITY_VERLET     // x += v dt + a dt^2/2   | forces | v += (a_old + a) dt/2
+};
+
+/*
+structure of arrays: every component lives in its own cache line aligned array, so loops over
+the bodies load full vector registers without shuffling x and y apart.
+the arrays are padded to a multiple of PADDING with massless bodies at the origin, kernels
+may run over the padded size and the padding adds exactly 0.
+
+pos, vel and acc are views that give the old Vec2 interface (bodies->pos[i].x, bodies->vel[i] = ...).
+*/
 class Bodies {
+private:
+    void resize_arrays(unsigned num_bodies);
+
 public:
-    std::vector<Vec2> pos;
-    std::vector<Vec2> vel;
-    std::vector<Vec2> acc;
+    // scalars per cache line, also the widest vector register
+    static constexpr unsigned PADDING = 64 / sizeof(real);
+
+    AlignedVector<real> x, y;
+    AlignedVector<real> vx, vy;
+    AlignedVector<real> ax, ay;
+    AlignedVector<real> mass;
+    AlignedVector<real> radius;
 
-    std::vector<double> mass;
-    std::vector<double> radius;
+    Vec2Array pos;
+    Vec2Array vel;
+    Vec2Array acc;
 
-    std::vector<bool> to_be_deleted;
+    // one byte per body (not vector<bool>), so threads can flag different bodies at the same time
+    std::vector<uint8_t> to_be_deleted;
 
     unsigned size;
     unsigned width, height;
 
+    enum Integrator integrator = LEAPFROG_KDK;
+
+    /*
+    block timesteps: body i moves with dt / 2^time_level[i]. a step is cut into 2^max_time_level substeps,
+    only the bodies at the end of their own step get a new force, and substeps at which no step ends are skipped.
+    the level is picked from the acceleration, dt_i = time_step_accuracy * sqrt(eps / |a|), whenever a body starts a step.
+    block timesteps always use the kdk split, max_time_level = 0 moves everyone with the whole dt.
+    */
+    static constexpr unsigned MAX_TIME_LEVEL = 10;
+
+    std::vector<uint8_t> time_level;
+    unsigned max_time_level = 0;
+    unsigned substep = 0;                   // position within the step, in smallest substeps
+    double time_step_accuracy = 0.25;
+
     Bodies(unsigned num_bodies);
+
+    // the views point into this object
+    Bodies(const Bodies&) = delete;
+    Bodies& operator=(const Bodies&) = delete;
+
     inline void set_size(unsigned width, unsigned height)
     {
         width = width;
         height = height;
     }
 
-    void update(double dt);
+    inline unsigned get_padded_size() const { return static_cast<unsigned>(x.size()); }
+
+    /*
+    a step is split around the force pass: begin_step moves the bodies with the accelerations of the last step,
+    the force passes call finish_step for every body as soon as its new acceleration is known.
+    that way the closing kick needs no separate pass over the bodies.
+    */
+    void begin_step(double dt);
+    void begin_step(double dt, unsigned start, unsigned end);
+
+    /*
+    begin_step of the block timesteps, in two passes since the drift depends on the new levels:
+    the opening kick (and new level) of every body that starts a step in the current substep, returns how many did
+    and the deepest level in use. then everyone drifts up to the next substep at which a step ends.
+    */
+    unsigned kick_starting_bodies(double dt, unsigned start, unsigned end, unsigned& deepest_level);
+    void drift(double duration, unsigned start, unsigned end);
+
+    // half_step is half of the whole dt, the body scales it down to its own level
+    inline void finish_step(unsigned index, real new_ax, real new_ay, real half_step)
+    {
+        // verlet still has the old acceleration in ax / ay, kdk already used it in begin_step
+        const real old_weight = integrator == VELOCITY_VERLET && max_time_level == 0 ? real(1) : real(0);
+        const real body_half_step = std::ldexp(half_step, -static_cast<int>(time_level[index]));
+
+        vx[index] += (new_ax + old_weight * ax[index]) * body_half_step;
+        vy[index] += (new_ay + old_weight * ay[index]) * body_half_step;
+        ax[index] = new_ax;
+        ay[index] = new_ay;
+    }
+
+    // whether the body is at the start (and the end) of its own step in the current substep
+    inline bool is_active(unsigned index) const
+    {
+        return (substep & ((1u << (max_time_level - time_level[index])) - 1u)) == 0;
+    }
+
+    inline unsigned get_substeps() const { return 1u << max_time_level; }
+    void set_max_time_level(unsigned max_time_level);
+
     void resize(unsigned num_bodies);
     void clear();
 
-    void remove_merged_bodies();
+    // index_remap value of a body that was removed
+    static constexpr uint32_t REMOVED = UINT32_MAX;
+
+    // old index -> new index of the last remove_merged_bodies, REMOVED for the deleted ones
+    std::vector<uint32_t> index_remap;
+
+    // stable compaction in one pass over the arrays, returns index_remap
+    const std::vector<uint32_t>& remove_merged_bodies();
     void merge_bodies(unsigned keep_index, unsigned remove_index);
 
-    double get_lowest_density() const;
-    double get_highest_density() const;
     unsigned get_size() const;
 
     void add_force(unsigned index, const Vec2& force);
@@ -0,0 +1,90 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "Bodies.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+binary checkpoint of a run, everything needed to continue it exactly where it stopped.
+
+layout (native byte order, every array starts on a 64 byte boundary):
+    CheckpointHeader
+    rng state           rng_state_size bytes, the text form of std::mt19937
+    x, y, vx, vy, ax, ay, mass, radius      num_bodies scalars of real_size bytes each
+    time_level          num_bodies bytes
+
+a checkpoint written by a float build loads into a double build and the other way around, the arrays are converted.
+*/
+struct CheckpointHeader {
+    static constexpr char MAGIC[8] = { 'G', 'R', 'A', 'V', 'C', 'K', 'P', 'T' };
+    static constexpr uint32_t VERSION = 1;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t real_size;
+    uint64_t num_bodies;
+
+    double G, theta, dt;
+    int64_t steps;
+    double simulated_time;
+
+    uint32_t integrator;
+    uint32_t max_time_level;
+    double time_step_accuracy;
+
+    uint64_t rng_state_offset, rng_state_size;
+    uint64_t arrays_offset;
+    uint64_t file_size;
+};
+
+// the scalars of a run next to the bodies
+struct CheckpointState {
+    double G = 0.0, theta = 0.0, dt = 0.0;
+    long steps = 0;
+    double simulated_time = 0.0;
+    std::string rng_state;
+};
+
+/*
+writes checkpoints on a background thread: write() copies the state into a file image right away (one memcpy per array),
+so the bodies can change again as soon as it returns, and the thread only does the slow part.
+the file is written next to the target and renamed once complete, a crash never leaves a half written checkpoint behind.
+*/
+class CheckpointWriter {
+private:
+    static constexpr uint64_t ALIGNMENT = 64;
+
+    std::thread thread;
+    std::vector<char> image;
+    std::atomic<bool> busy { false };
+    std::atomic<bool> last_succeeded { true };
+    unsigned long skipped = 0;
+
+public:
+    CheckpointWriter() = default;
+    ~CheckpointWriter();
+
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+    // only one is written at a time: while the previous one is still going to the disk this one is skipped
+    // and false is returned, the caller never waits for the disk
+    bool write(const std::string& path, const Bodies& bodies, const CheckpointState& state);
+    void wait();
+
+    // whether the last finished write made it to the disk
+    inline bool succeeded() const { return last_succeeded; }
+    inline unsigned long get_skipped() const { return skipped; }
+
+    static uint64_t align(uint64_t offset) { return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT; }
+};
+
+// maps the file and copies it into bodies, false (and bodies untouched) if it is missing or not a valid checkpoint
+bool read_checkpoint(const std::string& path, Bodies& bodies, CheckpointState& state);
+
+#endif // CHECKPOINT_H
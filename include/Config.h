@@ -0,0 +1,61 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include "FrameExporter.h"
+#include "SimulationManager.h"
+
+#include <memory>
+#include <string>
+
+/*
+settings of a simulation as read from CONFIG.cfg, shared by the viewer and the headless runner.
+the defaults are used for every key the file does not set.
+*/
+struct Config {
+    double G = 6.67408e-3;          // 10e8 stronger gravity
+    double theta = 1.2;
+    double dt = 0.05;
+    unsigned body_count = 100000;
+    double mass = 10;
+    int height = 2200;
+    int width = 2200;
+    unsigned threads = 0;           // 0 = all hardware threads
+    bool pin_threads = false;
+    unsigned leaf_capacity = 0;     // 0 = tuned at runtime
+    bool fmm = false;               // fast multipole method instead of barnes-hut
+    unsigned multipole_order = 6;
+    bool refit = false;             // refit the tree between full rebuilds
+    bool verlet = false;            // velocity verlet instead of kick drift kick leapfrog
+    unsigned time_levels = 0;       // block timesteps down to dt / 2^time_levels, 0 = one dt for every body
+    bool collisions = false;        // merge bodies whose radii overlap
+    double time_rate = 0.0;         // simulated time per second in the viewer, 0 = as fast as possible
+    unsigned max_catch_up = 4;      // steps at most per wake up of the physics thread when it falls behind
+    std::string checkpoint = "checkpoint.gsim";     // restarts from it if it exists, saves go there too
+    bool restart = false;           // continue from the checkpoint instead of starting with new bodies
+    unsigned checkpoint_every = 0;  // steps between checkpoints, 0 = only on request
+    std::string trajectory = "trajectory.gtraj";    // where recordings go
+    bool record = false;            // record from the start
+    unsigned record_every = 1;      // steps between recorded frames
+    double record_bandwidth = 0.0;  // MB/s written at most, 0 = unlimited. frames that do not fit are dropped
+    unsigned position_bits = 20;    // of the quantized positions and velocities, between 8 and 24
+    unsigned velocity_bits = 16;
+    unsigned keyframe_interval = 16;
+    bool export_frames = false;     // render every new snapshot offscreen and write it out, for videos
+    std::string export_path = "frame";  // frame_000000.png, ... or a single raw file
+    ExportFormat export_format = EXPORT_PNG;
+    unsigned export_width = 1920;
+    unsigned export_height = 1080;
+    unsigned export_threads = 0;    // encoder threads, 0 = all hardware threads
+    unsigned export_every = 1;      // steps between frames of gravity_headless, which draws them with the software rasterizer
+};
+
+// key = value lines, # starts a comment. returns false if the file could not be opened
+bool read_config(const std::string& config_file, Config& config);
+
+// a simulation with every setting of the config applied and its bodies added (or restored from the checkpoint), paused
+std::shared_ptr<SimulationManager> create_simulation(const Config& config);
+
+// an exporter with the export settings of the config, nullptr if its output could not be created
+std::shared_ptr<FrameExporter> create_exporter(const Config& config);
+
+#endif // CONFIG_H
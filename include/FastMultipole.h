@@ -0,0 +1,108 @@
+#ifndef FAST_MULTIPOLE_H
+#define FAST_MULTIPOLE_H
+
+#include "QuadTree.h"
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <complex>
+#include <memory>
+#include <vector>
+
+/*
+fast multipole method on top of the quadtree, O(n) instead of the O(n log n) of the tree walk.
+
+in 2D the (unsoftened) force law is a complex function: with z the position of a body and w_j the sources,
+    a(z) = G * sum m_j (w_j - z) / |w_j - z|^2 = -G * conj(g(z)),   g(z) = sum m_j / (z - w_j)
+so every cell keeps a multipole expansion of g around its center of mass
+    g(z) = sum_k a_k / (z - c)^(k+1),   a_k = sum m_j (w_j - c)^k
+and a local expansion of the field of everything far away
+    g(z) = sum_l b_l (z - c)^l
+both up to the configurable order p.
+
+the cells are paired by a dual tree traversal: two cells whose radii are small compared to their distance
+(r_a + r_b < opening_angle * distance) interact through one multipole to local translation, neighbouring
+leaves are summed directly with the softened force law.
+the far field is unsoftened (off by about eps^2 / distance^2), larger leaves push it further out,
+so the fmm runs with larger leaves than the tree walk.
+
+with block timesteps the multipoles still need every body, but only cells with active bodies are targets:
+pairs into cells without any are skipped, and the local expansions and direct sums stop at them.
+
+the traversal above the subtree tasks of the tree build is done serially, every pair that reaches a task root is
+deferred to that task. the tasks then only ever write into their own subtree, so they run in parallel without locks.
+*/
+class FastMultipole {
+private:
+    static constexpr unsigned MAX_ORDER = 20;
+
+    using Complex = std::complex<double>;
+
+    std::shared_ptr<QuadTree> tree;
+    std::shared_ptr<ThreadPool> thread_pool;
+
+    unsigned order = 6;
+    double opening_angle = 0.7;
+
+    // (order + 1) coefficients per node
+    std::vector<Complex> multipoles;
+    std::vector<Complex> locals;
+    std::vector<double> radius;
+    std::vector<uint32_t> active_count;     // per node, bodies that take a force in this pass
+
+    // per body in morton order, whether it takes a force in this pass
+    std::vector<uint8_t> body_active;
+
+    // binomial[n * (2 * MAX_ORDER + 1) + k] = n choose k
+    std::vector<double> binomial;
+
+    // shifted_binomial[k * (MAX_ORDER + 1) + l] = (k + l) choose k, contiguous in l for the multipole to local loop
+    std::vector<double> shifted_binomial;
+
+    // field of every body in morton order, without G. the expansions stay in double in a float build too
+    std::vector<Vec2T<double>> body_acc;
+
+    uint32_t top_level_count = 0;
+    std::vector<int32_t> task_of_node;                              // -1 for top level nodes that are not a task root
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> pending; // (target, source) per task
+
+    std::vector<InteractionList> thread_lists;
+    std::vector<unsigned long> thread_calculations;
+
+    // std::complex checks every product for inf / nan (unless compiled with -ffast-math), which makes it a function call
+    static inline Complex multiply(const Complex& a, const Complex& b)
+    {
+        return Complex(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+    }
+
+    inline double choose(unsigned n, unsigned k) const { return binomial[n * (2 * MAX_ORDER + 1) + k]; }
+    inline Complex center(uint32_t node_index) const
+    {
+        const Vec2& com = tree->nodes[node_index].center_of_mass;
+        return Complex(com.x, com.y);
+    }
+
+    void upward_pass(uint32_t node_index);
+    void downward_pass(uint32_t node_index);
+
+    // deferring is only allowed during the serial part
+    void interact(uint32_t target, uint32_t source, bool defer, InteractionList& list, unsigned long& calculations);
+
+    void multipole_to_local(uint32_t target, uint32_t source);
+    void particle_to_particle(uint32_t target, uint32_t source, InteractionList& list);
+
+public:
+    FastMultipole(std::shared_ptr<QuadTree> tree, std::shared_ptr<ThreadPool> thread_pool);
+
+    // the tree has to be built, fills bodies->acc and finishes the step like QuadTree::update
+    void update(double G, double dt, unsigned long& calculations_per_frame);
+
+    inline void set_order(unsigned order) { this->order = std::clamp(order, 1u, MAX_ORDER); }
+    inline unsigned get_order() const { return order; }
+
+    // below 1, smaller is more accurate and slower
+    inline void set_opening_angle(double opening_angle) { this->opening_angle = std::clamp(opening_angle, 0.05, 0.95); }
+    inline double get_opening_angle() const { return opening_angle; }
+};
+
+#endif // FAST_MULTIPOLE_H
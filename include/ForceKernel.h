@@ -0,0 +1,225 @@
+#ifndef FORCE_KERNEL_H
+#define FORCE_KERNEL_H
+
+#include "Real.h"
+
+#include <vector>
+
+/*
+the tree walk does not compute any forces itself, it only collects what a body interacts with
+(accepted cells and the bodies of opened leaves) into an interaction list. the list is stored as
+structure of arrays and padded to the vector width, so the kernel below is one branch free loop
+that the compiler turns into AVX / NEON code.
+
+the kernel accumulates the acceleration directly, the mass of the body itself never shows up.
+the lists and the per lane math are in the simulation precision (real), the partial sums in accumulator.
+
+accepted cells can also be kept in a quadrupole list: besides the total mass a cell then carries the
+second moments of its bodies around the center of mass. expanding m * d / (|d|^2 + eps^2) to second
+order around the center of mass (r = com - x, D = |r|^2 + eps^2, S the second moments) adds
+
+    -2 S r / D^2  -  r tr(S) / D^2  +  4 r (r S r) / D^3
+
+to the monopole term, the first order term is 0 around the center of mass.
+*/
+
+// softening factor, else force goes BRRRRRT
+constexpr real SOFTENING_SQUARED = 2.0;
+
+// scalars per vector register of the target, the kernel keeps this many independent partial sums
+#if defined(__AVX512F__)
+constexpr unsigned SIMD_WIDTH = 64 / sizeof(real);
+#elif defined(__AVX__)
+constexpr unsigned SIMD_WIDTH = 32 / sizeof(real);
+#else // SSE2 and NEON
+constexpr unsigned SIMD_WIDTH = 16 / sizeof(real);
+#endif
+
+class InteractionList {
+private:
+    unsigned count = 0;
+
+    void grow()
+    {
+        const std::size_t capacity = x.empty() ? 1024 : x.size() * 2;
+        x.resize(capacity);
+        y.resize(capacity);
+        mass.resize(capacity);
+    }
+
+public:
+    std::vector<real> x, y, mass;
+
+    inline void clear() { count = 0; }
+    inline unsigned size() const { return count; }
+    inline unsigned padded_size() const { return (count + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH; }
+
+    inline void push(real x, real y, real mass)
+    {
+        reserve_more(1);
+        push_unchecked(x, y, mass, true);
+    }
+
+    // makes sure the next n entries fit (plus the padding)
+    inline void reserve_more(unsigned n)
+    {
+        while ( count + n + SIMD_WIDTH > this->x.size() )
+        {
+            grow();
+        }
+    }
+
+    // always writes the slot but only keeps it when keep is set, lets the tree walk push without branching
+    inline void push_unchecked(real x, real y, real mass, bool keep)
+    {
+        this->x[count] = x;
+        this->y[count] = y;
+        this->mass[count] = mass;
+        count += keep;
+    }
+
+    // massless entries up to the next multiple of the vector width, they add exactly 0
+    inline void pad()
+    {
+        for ( unsigned i = count; i < padded_size(); ++i )
+        {
+            x[i] = 0.0;
+            y[i] = 0.0;
+            mass[i] = 0.0;
+        }
+    }
+};
+
+class QuadrupoleList {
+private:
+    unsigned count = 0;
+
+    void grow()
+    {
+        const std::size_t capacity = x.empty() ? 1024 : x.size() * 2;
+        x.resize(capacity);
+        y.resize(capacity);
+        mass.resize(capacity);
+        xx.resize(capacity);
+        xy.resize(capacity);
+        yy.resize(capacity);
+    }
+
+public:
+    std::vector<real> x, y, mass;
+    std::vector<real> xx, xy, yy;     // mass weighted second moments around (x, y)
+
+    inline void clear() { count = 0; }
+    inline unsigned size() const { return count; }
+    inline unsigned padded_size() const { return (count + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH; }
+
+    inline void reserve_more(unsigned n)
+    {
+        while ( count + n + SIMD_WIDTH > this->x.size() )
+        {
+            grow();
+        }
+    }
+
+    inline void push_unchecked(real x, real y, real mass, real xx, real xy, real yy, bool keep)
+    {
+        this->x[count] = x;
+        this->y[count] = y;
+        this->mass[count] = mass;
+        this->xx[count] = xx;
+        this->xy[count] = xy;
+        this->yy[count] = yy;
+        count += keep;
+    }
+
+    inline void pad()
+    {
+        for ( unsigned i = count; i < padded_size(); ++i )
+        {
+            x[i] = 0.0;
+            y[i] = 0.0;
+            mass[i] = 0.0;
+            xx[i] = 0.0;
+            xy[i] = 0.0;
+            yy[i] = 0.0;
+        }
+    }
+};
+
+// sum of mass * d / (|d|^2 + eps^2) over the (padded) list, multiply by G to get the acceleration
+inline void evaluate_interactions(const InteractionList& list, real pos_x, real pos_y, accumulator& acc_x, accumulator& acc_y)
+{
+    const real* __restrict x = list.x.data();
+    const real* __restrict y = list.y.data();
+    const real* __restrict mass = list.mass.data();
+    const unsigned size = list.padded_size();
+
+    accumulator sum_x[SIMD_WIDTH] = {};
+    accumulator sum_y[SIMD_WIDTH] = {};
+
+    for ( unsigned i = 0; i < size; i += SIMD_WIDTH )
+    {
+        for ( unsigned lane = 0; lane < SIMD_WIDTH; ++lane )
+        {
+            const real dx = x[i + lane] - pos_x;
+            const real dy = y[i + lane] - pos_y;
+            const real factor = mass[i + lane] / (dx * dx + dy * dy + SOFTENING_SQUARED);
+
+            sum_x[lane] += dx * factor;
+            sum_y[lane] += dy * factor;
+        }
+    }
+
+    acc_x = 0.0;
+    acc_y = 0.0;
+    for ( unsigned lane = 0; lane < SIMD_WIDTH; ++lane )
+    {
+        acc_x += sum_x[lane];
+        acc_y += sum_y[lane];
+    }
+}
+
+// same as above for cells with second moments, adds to acc_x / acc_y instead of overwriting them
+inline void evaluate_quadrupoles(const QuadrupoleList& list, real pos_x, real pos_y, accumulator& acc_x, accumulator& acc_y)
+{
+    const real* __restrict x = list.x.data();
+    const real* __restrict y = list.y.data();
+    const real* __restrict mass = list.mass.data();
+    const real* __restrict xx = list.xx.data();
+    const real* __restrict xy = list.xy.data();
+    const real* __restrict yy = list.yy.data();
+    const unsigned size = list.padded_size();
+
+    accumulator sum_x[SIMD_WIDTH] = {};
+    accumulator sum_y[SIMD_WIDTH] = {};
+
+    for ( unsigned i = 0; i < size; i += SIMD_WIDTH )
+    {
+        for ( unsigned lane = 0; lane < SIMD_WIDTH; ++lane )
+        {
+            const real rx = x[i + lane] - pos_x;
+            const real ry = y[i + lane] - pos_y;
+            const real inv = real(1) / (rx * rx + ry * ry + SOFTENING_SQUARED);
+
+            const real s_rx = xx[i + lane] * rx + xy[i + lane] * ry;
+            const real s_ry = xy[i + lane] * rx + yy[i + lane] * ry;
+            const real r_s_r = rx * s_rx + ry * s_ry;
+            const real trace = xx[i + lane] + yy[i + lane];
+
+            // monopole + the quadrupole correction from above
+            const real radial = mass[i + lane] * inv + inv * inv * (real(4) * r_s_r * inv - trace);
+            const real inv_squared = real(-2) * inv * inv;
+
+            sum_x[lane] += rx * radial + s_rx * inv_squared;
+            sum_y[lane] += ry * radial + s_ry * inv_squared;
+        }
+    }
+
+    for ( unsigned lane = 0; lane < SIMD_WIDTH; ++lane )
+    {
+        acc_x += sum_x[lane];
+        acc_y += sum_y[lane];
+    }
+}
+
+#endif // FORCE_KERNEL_H
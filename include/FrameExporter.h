@@ -0,0 +1,89 @@
+#ifndef FRAME_EXPORTER_H
+#define FRAME_EXPORTER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// width * height rgba pixels, rows top to bottom. false if the file could not be written
+bool write_png(const std::string& path, unsigned width, unsigned height, const uint8_t* rgba);
+
+enum ExportFormat {
+    EXPORT_PNG,     // path_000000.png, path_000001.png, ... encoded in parallel
+    EXPORT_RAW      // every frame appended to path as raw rgba, e.g. for ffmpeg -f rawvideo -pix_fmt rgba -s WxH -i path
+};
+
+/*
+hands rendered frames to a pool of encoder threads. the producer fills a buffer from acquire() and passes it on
+with submit(), everything after that (encoding, writing) happens on the pool.
+there are a few more buffers than threads: acquire() only waits once all of them are in flight, so a producer
+that is faster than the disk is slowed down to its pace instead of piling up frames in memory.
+raw frames go to a single file and are written by one thread, in the order they were submitted.
+*/
+class FrameExporter {
+private:
+    struct Frame {
+        std::vector<uint8_t> pixels;
+        unsigned long index = 0;
+    };
+
+    std::string path;
+    ExportFormat format;
+    unsigned width, height;
+    FILE* raw_file = nullptr;
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable frame_queued;
+    std::condition_variable frame_done;
+    bool stopping = false;
+
+    std::vector<std::unique_ptr<Frame>> frames;
+    std::vector<Frame*> free_frames;
+    std::deque<Frame*> queued_frames;
+    unsigned in_flight = 0;
+
+    Frame* current = nullptr;   // acquired and not submitted yet
+    unsigned long next_index = 0;
+
+    std::atomic<unsigned long> exported_frames { 0 };
+    std::atomic<unsigned long> failed_frames { 0 };
+    std::atomic<double> encode_time { 0.0 };    // ms summed over every frame and thread
+
+    void work();
+    void export_frame(const Frame& frame);
+
+public:
+    // threads = 0 uses all hardware threads (raw always writes with one)
+    FrameExporter(const std::string& path, ExportFormat format, unsigned width, unsigned height, unsigned threads = 0);
+    ~FrameExporter();
+
+    FrameExporter(const FrameExporter&) = delete;
+    FrameExporter& operator=(const FrameExporter&) = delete;
+
+    // false if the raw file could not be created
+    inline bool is_open() const { return format != EXPORT_RAW || raw_file != nullptr; }
+
+    // width * height * 4 bytes to render the next frame into, waits while every buffer is in flight
+    uint8_t* acquire();
+    void submit();
+
+    // waits until every submitted frame is written
+    void flush();
+
+    inline unsigned get_width() const { return width; }
+    inline unsigned get_height() const { return height; }
+    inline unsigned long get_submitted_frames() const { return next_index; }
+    inline unsigned long get_exported_frames() const { return exported_frames; }
+    inline unsigned long get_failed_frames() const { return failed_frames; }
+    inline double get_encode_time() const { return encode_time; }
+};
+
+#endif // FRAME_EXPORTER_H
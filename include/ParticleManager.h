@@ -2,8 +2,12 @@
 #define PARTICLE_MANAGER_H
 
 #include "Bodies.h"
+#include "ThreadPool.h"
 
+#include <memory>
 #include <random>
+#include <sstream>
+#include <string>
 
 enum BodyType {
     SPINNING_CIRCLE,
@@ -17,10 +21,17 @@ enum BodyType {
 class ParticleManager {
 private:
     std::shared_ptr<Bodies> bodies;
+    std::shared_ptr<ThreadPool> thread_pool;
     enum BodyType body_type;
     double mass;
     unsigned width, height;
 
+    std::vector<Vec2> thread_top_left, thread_bottom_right;
+
+    // every generator draws from this one, so a checkpoint can store where the sequence is
+    std::mt19937 gen;
+    inline double random_unit() { return std::uniform_real_distribution<double>(0.0, 1.0)(gen); }
+
     void add_spinning_circle(unsigned num_bodies, double mass);
     void add_galaxy(unsigned num_bodies, double mass);
     void add_rotating_cubes(unsigned num_bodies, double mass);
@@ -29,12 +40,16 @@ private:
     void add_custom_shape1(unsigned count, double mass);
 
 public:
-    ParticleManager(std::shared_ptr<Bodies> bodies, unsigned width, unsigned height);
+    ParticleManager(std::shared_ptr<Bodies> bodies, unsigned width, unsigned height, std::shared_ptr<ThreadPool> thread_pool = nullptr);
     ~ParticleManager();
 
     void add_bodies(BodyType type = BodyType::GALAXY, unsigned num_bodies = 20000, double mass = 1.0);
     void get_particle_area(Vec2& top_left, Vec2& bottom_right);
     void reset();
+
+    inline void set_seed(unsigned seed) { gen.seed(seed); }
+    std::string get_rng_state() const;
+    bool set_rng_state(const std::string& rng_state);
 };
 
 #endif // PARTICLE_MANAGER_H
\ No newline at end of file
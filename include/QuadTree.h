@@ -2,61 +2,251 @@
 #define QUAD_TREE_H
 
 #include "Bodies.h"
+#include "ForceKernel.h"
+#include "ThreadPool.h"
 #include "Vec2.h"
 
 #include <iostream>
-#include <SFML/Graphics.hpp>
+#include <cstdint>
 #include <vector>
-#include <stack>
-#include <queue>
-#include <future>
-
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+
+/*
+the tree lives in one contiguous node array that is reused across frames,
+children are referenced by 32 bit indices instead of pointers.
+the four children of a node are always stored next to each other (NW, NE, SW, SE)
+so a node only needs to know where the first one is.
+
+the tree is built from the bodies sorted along a morton (z-order) curve:
+every node then covers a contiguous range of the sorted bodies and the
+subtrees below a fixed level can be built (and their moments computed) in parallel.
+
+forces are computed per group of nearby bodies: the group walks the tree once,
+testing cells against its bounding box, and every member evaluates the shared list.
+
+with quadrupoles enabled every node also stores the second moments of its bodies around its
+center of mass, accepted cells are then evaluated to second order (see ForceKernel.h).
+that allows a larger theta for the same error.
+*/
 class QuadTree {
 private:
-    Vec2 top_left, bottom_right; //bounding box
-
-    Vec2 center_of_mass = Vec2(0, 0);
-    double mass = 0.0;
-
-    int body_index = -1;
-
-    std::unique_ptr<QuadTree> NW;
-    std::unique_ptr<QuadTree> NE;
-    std::unique_ptr<QuadTree> SW;
-    std::unique_ptr<QuadTree> SE;
-
-    // 0, 255, 0, 100
-    sf::Color color = sf::Color(0, 255, 0, 100);
-
-    std::shared_ptr<sf::VertexArray> rectangles;
-
-    void insert(unsigned index);
-
-    bool subdivide();
-    QuadTree* get_child_quadrant(unsigned index);
-
-    void add_subdivision_bounds();
-    void add_root_bounds();
-
-    bool contains(unsigned index) const;
-    inline bool is_leaf() const { return NW == nullptr && NE == nullptr && SW == nullptr && SE == nullptr; }
-
-    double calculate_gravitational_force(double G, double mass1, double mass2, double squared_distance) const;
-    void compute_force(unsigned index, double theta, double G, unsigned long& calculations_per_frame);
+    // reads the nodes, the sorted bodies and the build tasks
+    friend class FastMultipole;
+
+    // one morton digit per level, 16 bits per axis
+    static constexpr unsigned MAX_DEPTH = 16;
+
+    // leaves hold up to leaf_capacity bodies, the auto tuner stays within [1, MAX_LEAF_CAPACITY]
+    static constexpr unsigned MAX_LEAF_CAPACITY = 64;
+
+    // steps averaged per measurement of the auto tuner, and windows it rests after settling
+    static constexpr unsigned TUNE_WINDOW = 8;
+    static constexpr unsigned TUNE_REST_WINDOWS = 32;
+
+    // subtrees below this level are built as independent tasks (up to 4^SPLIT_LEVEL of them)
+    static constexpr unsigned SPLIT_LEVEL = 4;
+
+    // below this many bodies waking up the workers costs more than it saves
+    static constexpr unsigned PARALLEL_THRESHOLD = 4096;
+
+    // defaults of the refit mode: full rebuild at least every REBUILD_INTERVAL steps, or once
+    // the children of a node overlap by more than REFIT_OVERLAP_THRESHOLD of the node area (summed over the tree)
+    static constexpr unsigned REBUILD_INTERVAL = 8;
+    static constexpr double REFIT_OVERLAP_THRESHOLD = 0.15;
+
+    // the force pass is cut into this many chunks per thread, threads grab them until none are left
+    static constexpr unsigned CHUNKS_PER_THREAD = 16;
+
+    struct Node {
+        Vec2 center_of_mass = Vec2(0, 0);
+        real mass = 0;
+
+        // mass weighted second moments around the center of mass, only filled with quadrupoles enabled
+        real quad_xx = 0;
+        real quad_xy = 0;
+        real quad_yy = 0;
+
+        Vec2 center;        // geometric center of the cell, after a refit the center of the bounding square
+        real half_size = 0;
+
+        uint32_t first_child = 0;   // 0 means leaf, the root is never anyones child
+        uint32_t first_body = 0;    // range in the morton sorted body arrays
+        uint32_t body_count = 0;
+
+        inline bool is_leaf() const { return first_child == 0; }
+    };
+
+    struct BuildTask {
+        uint32_t node_index;
+        unsigned level;
+        uint32_t offset;    // where the subtree ends up in nodes
+    };
+
+    std::vector<Node> nodes;
+
+    // bodies in morton order, leaves and subtrees reference ranges of these
+    std::vector<uint32_t> keys, keys_tmp;
+    std::vector<uint32_t> order, order_tmp;
+    std::vector<Vec2> body_pos;
+    std::vector<real> body_mass;
+
+    std::vector<uint32_t> histograms;
+    std::vector<BuildTask> build_tasks;
+    std::vector<std::vector<Node>> task_nodes;
+
+    std::shared_ptr<ThreadPool> thread_pool;
+    std::vector<unsigned long> thread_calculations;
+    std::vector<InteractionList> thread_lists;
+    std::vector<QuadrupoleList> thread_cell_lists;
+
+    // quadrupole is the setting, the nodes only have the moments if it was set during the last build
+    bool quadrupole = false;
+    bool built_with_quadrupoles = false;
+
+    // load balancing, the interactions of the last step are used as the cost of a body (and its group)
+    bool load_balancing = true;
+    std::vector<uint32_t> body_cost;
+    std::vector<uint32_t> chunk_bounds;
+    unsigned long last_total_cost = 0;
+
+    std::vector<double> thread_busy_time;   // ms per thread spent walking the tree in the last force pass
+    std::vector<double> thread_idle_time;   // ms per thread spent waiting for the others
+
+    // a leaf is only split once it holds more than leaf_capacity bodies, their forces are summed directly
+    unsigned leaf_capacity = 8;
+
+    // hill climbing over powers of two on the measured build + force time
+    bool auto_tune_leaf_capacity = false;
+    unsigned best_leaf_capacity = 8;
+    double best_step_time = 0.0;
+    double tune_time = 0.0;
+    unsigned tune_steps = 0;
+    unsigned tune_failures = 0;
+    unsigned tune_rest = 0;
+    int tune_direction = 1;
+
+    // refit mode keeps the topology and the morton order and only recomputes moments and bounds
+    bool refit_enabled = false;
+    unsigned rebuild_interval = REBUILD_INTERVAL;
+    double overlap_threshold = REFIT_OVERLAP_THRESHOLD;
+    unsigned steps_since_rebuild = 0;
+    double last_overlap = 0.0;
+    bool last_was_refit = false;
+    unsigned long refit_count = 0;
+    unsigned long rebuild_count = 0;
+    std::vector<double> thread_overlap, thread_area;
+
+    // collision broad phase, radii in morton order and what every thread found
+    std::vector<real> body_radius;
+    std::vector<real> thread_max_radius;
+    std::vector<std::vector<uint32_t>> thread_candidates;
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> thread_collisions;
+
+    double last_build_time = 0.0;   // ms, build or refit
+    double last_force_time = 0.0;   // ms
+
+    // bodies of a subtree with at most group_size bodies share one tree walk and one interaction list
+    unsigned group_size = 64;
+    std::vector<uint32_t> groups;
+
+    // cell borders for drawing, two points per line
+    std::vector<Vec2T<float>> bound_lines;
+    bool bound_lines_dirty = true;
+
+    template <typename Function>
+    void run_parallel(unsigned threads, Function&& function);
+
+    void compute_chunk_bounds(unsigned num_chunks);
+    void tune_leaf_capacity(double step_time);
+
+    void compute_keys(const Vec2& origin, double size);
+    void sort_keys();
+    void build_top_levels(uint32_t node_index, unsigned level);
+    Node build_subtree(std::vector<Node>& out, Node node, unsigned level);
+    void compute_leaf_moments(Node& node) const;
+    void compute_internal_moments(Node& node, const Node* children) const;
+    void fit_leaf_bounds(Node& node) const;
+    double fit_internal_bounds(Node& node, const Node* children) const;
+    void copy_sorted_bodies(unsigned threads);
+    void refit();
+    uint32_t split_range(uint32_t first, uint32_t last, unsigned level, uint32_t quadrant) const;
+
+    void add_subdivision_bounds(const Node& node);
+    void add_root_bounds(const Node& node);
+
+    void collect_groups(uint32_t node_index);
+    template <bool QUADRUPOLE>
+    void collect_interactions(const Vec2& box_min, const Vec2& box_max, real theta_squared, InteractionList& list, QuadrupoleList& cells) const;
+    void collect_collisions(const Node& group, real max_radius, std::vector<uint32_t>& candidates, std::vector<std::pair<uint32_t, uint32_t>>& found) const;
+    template <bool QUADRUPOLE>
+    void compute_group_forces(const Node& group, double theta, double G, real half_step, InteractionList& list, QuadrupoleList& cells, unsigned long& calculations_per_frame);
 
 public:
     std::shared_ptr<Bodies> bodies;
 
-    QuadTree(std::shared_ptr<Bodies> bodies, Vec2 top_left, Vec2 bottom_right, std::shared_ptr<sf::VertexArray> rectangles = nullptr, bool is_root = false);
-    QuadTree(std::shared_ptr<Bodies> bodies, double xmin, double ymin, double xmax, double ymax, std::shared_ptr<sf::VertexArray> rectangles = nullptr, bool is_root = false);
+    QuadTree(std::shared_ptr<Bodies> bodies, std::shared_ptr<ThreadPool> thread_pool);
+    QuadTree(std::shared_ptr<Bodies> bodies, std::shared_ptr<ThreadPool> thread_pool, Vec2 top_left, Vec2 bottom_right);
+    QuadTree(std::shared_ptr<Bodies> bodies, std::shared_ptr<ThreadPool> thread_pool, double xmin, double ymin, double xmax, double ymax);
 
     ~QuadTree();
 
+    void build(Vec2 top_left, Vec2 bottom_right);
+
+    // refits when refit mode is on and the tree is still good enough, rebuilds otherwise
+    void rebuild_or_refit(Vec2 top_left, Vec2 bottom_right);
+
+    // fills bodies->acc and finishes the step of bodies->begin_step, dt = 0 only computes the accelerations
     void update(double theta, double G, double dt, unsigned long& calculations_per_frame);
 
-    inline sf::VertexArray* get_bounding_rectangles() const { return rectangles.get(); }
-    inline Vec2 get_center_of_mass() const { return center_of_mass; }
-    inline void get_size(Vec2& top_left, Vec2& bottom_right) const { top_left = this->top_left; bottom_right = this->bottom_right; }
+    // every pair of bodies whose radii overlap, as sorted (lower, higher) body indices. uses the last build,
+    // the bodies must not have moved since
+    void find_collisions(std::vector<std::pair<uint32_t, uint32_t>>& pairs);
+
+    // moves the per body costs of the load balancer along with Bodies::remove_merged_bodies
+    void remap_bodies(const std::vector<uint32_t>& remap);
+
+    // take effect with the next build
+    inline void set_leaf_capacity(unsigned leaf_capacity) { this->leaf_capacity = std::clamp(leaf_capacity, 1u, MAX_LEAF_CAPACITY); }
+    inline unsigned get_leaf_capacity() const { return leaf_capacity; }
+    void set_auto_tune_leaf_capacity(bool auto_tune);
+    inline bool get_auto_tune_leaf_capacity() const { return auto_tune_leaf_capacity; }
+
+    inline void set_quadrupole(bool quadrupole) { this->quadrupole = quadrupole; }
+    inline bool get_quadrupole() const { return quadrupole; }
+
+    inline void set_group_size(unsigned group_size) { this->group_size = std::max(1u, group_size); }
+    inline unsigned get_group_size() const { return group_size; }
+
+    inline void set_load_balancing(bool load_balancing) { this->load_balancing = load_balancing; }
+    inline bool get_load_balancing() const { return load_balancing; }
+
+    inline void set_refit(bool refit_enabled) { this->refit_enabled = refit_enabled; }
+    inline bool get_refit() const { return refit_enabled; }
+    inline void set_rebuild_interval(unsigned rebuild_interval) { this->rebuild_interval = std::max(1u, rebuild_interval); }
+    inline void set_overlap_threshold(double overlap_threshold) { this->overlap_threshold = overlap_threshold; }
+
+    inline bool get_last_was_refit() const { return last_was_refit; }
+    inline double get_last_overlap() const { return last_overlap; }
+    inline unsigned long get_refit_count() const { return refit_count; }
+    inline unsigned long get_rebuild_count() const { return rebuild_count; }
+
+    // ms spent in the last build (or refit) and force pass
+    inline double get_build_time() const { return last_build_time; }
+    inline double get_force_time() const { return last_force_time; }
+    inline const std::vector<double>& get_thread_busy_time() const { return thread_busy_time; }
+    inline const std::vector<double>& get_thread_idle_time() const { return thread_idle_time; }
+
+    const std::vector<Vec2T<float>>& get_bounding_lines();
+    inline std::size_t get_node_count() const { return nodes.size(); }
+    inline Vec2 get_center_of_mass() const { return nodes[0].center_of_mass; }
+    inline void get_size(Vec2& top_left, Vec2& bottom_right) const
+    {
+        top_left = nodes[0].center - Vec2(nodes[0].half_size, nodes[0].half_size);
+        bottom_right = nodes[0].center + Vec2(nodes[0].half_size, nodes[0].half_size);
+    }
 };
 
-#endif // QUADTREE_H
\ No newline at end of file
+#endif // QUADTREE_H
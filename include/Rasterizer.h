@@ -0,0 +1,70 @@
+#ifndef RASTERIZER_H
+#define RASTERIZER_H
+
+#include "Real.h"
+#include "ThreadPool.h"
+
+#include <cstdint>
+#include <vector>
+
+// the palette of the viewer, t in [0, 1] from low to high density
+void density_color(double t, uint8_t& r, uint8_t& g, uint8_t& b);
+
+/*
+draws bodies as single points on the cpu, for machines without a gpu or a display.
+every pixel counts the bodies that land on it, the counts are tone mapped with log(1 + count) / log(1 + highest count)
+onto the palette of the viewer, empty pixels stay black.
+
+the image is cut into TILE_SIZE x TILE_SIZE tiles. the bodies are sorted by tile with a counting sort
+(a histogram per thread, then every thread scatters its bodies to its own offsets), afterwards each thread
+counts a contiguous run of tiles, so the increments stay within a tile that fits into l1 and no two threads
+ever touch the same pixel. nothing is allocated once the buffers have grown to the body count.
+*/
+class Rasterizer {
+public:
+    static constexpr unsigned TILE_SIZE = 64;
+
+private:
+    static constexpr unsigned TILE_BITS = 12;                   // a pixel within a tile, TILE_SIZE * TILE_SIZE = 2^12
+    static constexpr uint32_t OUTSIDE = 0xFFFFFFFF;
+    static constexpr unsigned TILE_COST = 512;                  // clearing a tile, in bodies, for splitting the tiles between threads
+    static constexpr unsigned COLOR_TABLE_SIZE = 4096;          // counts below are looked up, above computed
+
+    unsigned width, height;
+    unsigned tiles_x, tiles_y, num_tiles;
+
+    // world rectangle that is drawn, pixels per world unit
+    double left = 0.0, top = 0.0;
+    double scale_x = 1.0, scale_y = 1.0;
+
+    std::vector<uint32_t> keys;                 // per body, tile << TILE_BITS | pixel within the tile, or OUTSIDE
+    std::vector<uint32_t> thread_offsets;       // per thread and tile, first counted then where the thread writes its bodies
+    std::vector<uint32_t> tile_offsets;         // where the bodies of a tile start in sorted, num_tiles + 1
+    std::vector<uint16_t> sorted;               // pixels within the tile, ordered by tile
+    std::vector<uint32_t> counts;               // per pixel
+    std::vector<uint32_t> thread_max;
+    std::vector<uint32_t> color_table;          // rgba per count
+
+    uint32_t highest_count = 0;
+    double render_time = 0.0;   // ms
+
+    void bin_bodies(ThreadPool& pool, const real* x, const real* y, unsigned count);
+    void count_tiles(ThreadPool& pool);
+    void tone_map(ThreadPool& pool, uint8_t* rgba);
+
+public:
+    Rasterizer(unsigned width, unsigned height);
+
+    // the world rectangle that ends up on the image, y points down like in the viewer
+    void set_view(double left, double top, double view_width, double view_height);
+
+    // writes width * height rgba pixels, rows top to bottom
+    void render(ThreadPool& pool, const real* x, const real* y, unsigned count, uint8_t* rgba);
+
+    inline unsigned get_width() const { return width; }
+    inline unsigned get_height() const { return height; }
+    inline uint32_t get_highest_count() const { return highest_count; }
+    inline double get_render_time() const { return render_time; }
+};
+
+#endif // RASTERIZER_H
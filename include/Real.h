@@ -0,0 +1,25 @@
+#ifndef REAL_H
+#define REAL_H
+
+/*
+scalar type of the simulation core (positions, velocities, masses, tree nodes and force kernels).
+double by default, configure with -DGRAVITY_SIM_FLOAT=ON (or define GRAVITY_SIM_FLOAT) for single precision:
+twice the vector width and half the memory traffic, the points end up as floats on screen anyway.
+
+accumulator is what long sums are added up in (force sums and centers of mass). it follows real unless
+GRAVITY_SIM_DOUBLE_ACCUMULATE is defined, then a float build still sums in double.
+bench/precision_bench compares the energy drift of the builds.
+*/
+#ifdef GRAVITY_SIM_FLOAT
+using real = float;
+#else
+using real = double;
+#endif
+
+#if defined(GRAVITY_SIM_FLOAT) && !defined(GRAVITY_SIM_DOUBLE_ACCUMULATE)
+using accumulator = float;
+#else
+using accumulator = double;
+#endif
+
+#endif // REAL_H
@@ -1,33 +1,124 @@
 #ifndef SIMULATION_MANAGER_H
 #define SIMULATION_MANAGER_H
 
-class Window;
-
-#include <SFML/Graphics.hpp>
+#include <atomic>
 #include <vector>
 #include <chrono>
+#include <mutex>
 #include <iomanip>
 #include <thread>
 #include <iostream>
 #include <sstream>
 
+#include "Checkpoint.h"
 #include "QuadTree.h"
-#include "Window.h"
+#include "Trajectory.h"
+#include "FastMultipole.h"
 #include "Bodies.h"
 #include "ParticleManager.h"
+#include "Snapshot.h"
+#include "ThreadPool.h"
+#include "TripleBuffer.h"
+
+enum ForceMethod {
+    BARNES_HUT,
+    FAST_MULTIPOLE
+};
 
 class SimulationManager {
+public:
+    // a setting change from another thread, see post
+    using Command = void (SimulationManager::*)();
+
 private:
     std::shared_ptr<Bodies> bodies;
-    Window* window;
+    std::shared_ptr<ThreadPool> thread_pool;
 
     std::shared_ptr<QuadTree> tree;
+    std::shared_ptr<FastMultipole> fast_multipole;
+    enum ForceMethod force_method;
+    unsigned inactive_leaf_capacity;    // the fmm wants larger leaves than the tree walk, each method keeps its own
     std::shared_ptr<ParticleManager> particle_manager;
-    std::vector<sf::RectangleShape*> bounding_boxes;
 
     // Simulation Settings
     double G, theta, dt;
 
+    // the first step needs the accelerations of the starting positions, they are computed once before it
+    bool accelerations_valid;
+
+    // levels used when block timesteps are switched on from the window
+    static constexpr unsigned BLOCK_TIME_LEVELS = 4;
+
+    // bodies that got a force per force pass of the last step (on average), and forces per body in the last step
+    double active_fraction;
+    double forces_per_body;
+    std::vector<unsigned> thread_deepest_level;
+
+    // colliding bodies merge at the end of every step
+    bool collisions;
+    std::atomic<unsigned> last_merges;
+    std::atomic<unsigned long> total_merges;
+    std::vector<std::pair<uint32_t, uint32_t>> collision_pairs;
+    std::vector<uint8_t> merged;
+
+    void merge_colliding_bodies();
+
+    void compute_forces(double dt);
+
+    /*
+    the viewer runs step() on a physics thread and draws on its own. everything it draws is copied into a snapshot
+    after a step, and every change it makes is queued and applied by the physics thread before the next step.
+    */
+    bool snapshots_enabled;
+    bool snapshot_dirty;    // something changed since the last snapshot
+    TripleBuffer<Snapshot> snapshots;
+
+    std::mutex command_mutex;
+    std::vector<Command> pending_commands;
+    std::vector<Command> running_commands;
+
+    void run_commands();
+    void publish_snapshot();
+    void write_snapshot_bodies(Snapshot& snapshot);
+
+    // the shades of a snapshot are scaled between the lowest and highest |a| of the snapshot before,
+    // |a| hardly changes from one to the next and so a single pass writes the shades and finds the next range
+    bool shade_range_valid;
+    double shade_lowest, shade_highest;
+    std::vector<std::pair<double, double>> thread_shade_range;
+
+    /*
+    fixed timestep: wall time times time_rate is accumulated and whole steps of dt are taken from it, so simulated time
+    advances at time_rate no matter how fast the steps are. at most max_catch_up_steps are taken at once, the rest is
+    dropped. a small budget keeps the snapshots smooth when the physics can not keep up, a large one keeps the rate.
+    time_rate = 0 steps as fast as possible.
+    */
+    static constexpr unsigned DEFAULT_MAX_CATCH_UP_STEPS = 4;
+    static constexpr double DEFAULT_TIME_RATE = 3.0;    // 60 steps per second with dt = 0.05
+    static constexpr double PAUSED_WAIT = 0.002;        // s
+
+    double time_rate;
+    unsigned max_catch_up_steps;
+    double time_accumulator;
+    double simulated_time;
+    double dropped_time;
+    double published_time;                  // simulated time since the last snapshot
+    std::chrono::steady_clock::time_point last_advance;
+    std::vector<Vec2T<float>> published_positions;
+
+    void physics_step();
+
+    // checkpoints go to checkpoint_path, every checkpoint_interval steps (0 = only when asked for)
+    CheckpointWriter checkpoint_writer;
+    std::string checkpoint_path;
+    unsigned checkpoint_interval;
+
+    // while recording every record_interval-th step goes to record_path
+    TrajectoryRecorder recorder;
+    std::string record_path;
+    unsigned record_interval;
+    void record_frame();
+
     // Simulation Toggles
     bool paused;
     bool draw_quadtree;
@@ -35,46 +126,74 @@ private:
     bool debug;
     bool toggle_verbose;
 
-    // Simulation Stats
-    long steps;
-    long unsigned total_calculations;
-    long unsigned calculations_per_frame;
+    // Simulation Stats, the counters are read from other threads
+    std::atomic<long> steps;
+    std::atomic<long unsigned> total_calculations;
+    std::atomic<long unsigned> calculations_per_frame;
 
+    // running averages over the steps, updated once per step
     double average_ratio_best_case;
     double average_ratio_worst_case;
 
     double calc_best_case;
     double calc_worst_case;
 
-    double elapsed_time_physics;
-    double elapsed_time_graphics;
-    double total_frame_time;
+    void update_average_ratios();
+
+    std::atomic<double> elapsed_time_physics;
 
 public:
-    SimulationManager(const int width, const int height, const char* title = "N-Body Simulation", double G = 6.67408e-11, double theta = 0.8, double dt = 0.1);
+    // num_threads = 0 uses every hardware thread
+    SimulationManager(const int width, const int height, const char* title = "N-Body Simulation", double G = 6.67408e-11, double theta = 0.8, double dt = 0.1, unsigned num_threads = 0, bool pin_threads = false);
     ~SimulationManager();
 
     void update_simulation();
-    void run();
+    void update_bodies();
+
+    // one frame of the physics, only runs the queued commands while paused. the frame loop is owned by the viewer or the headless runner
+    void step();
+
+    // steps as many times as the fixed timestep asks for (once without a time rate), returns the seconds until the next step is due
+    double advance();
+
+    // queues a setting change (a toggle or increase / decrease below), it runs on the thread calling step()
+    void post(Command command);
+
+    // snapshots are only copied out once they are enabled, the newest one stays valid until the next call
+    inline void enable_snapshots() { snapshots_enabled = true; }
+    const Snapshot& latest_snapshot();
 
     /*--------------------
     |   Member Setters   |
     ---------------------*/
-    inline void set_window(Window* window) { this->window = window; }
-    inline void add_bodies(unsigned count = 8000, double mass = 1.0, BodyType body_type = BodyType::RANDOM) { particle_manager->add_bodies(body_type, count, mass); }
+    inline void add_bodies(unsigned count = 8000, double mass = 1.0, BodyType body_type = BodyType::RANDOM)
+    {
+        particle_manager->add_bodies(body_type, count, mass);
+        accelerations_valid = false;
+    }
 
     /*--------------------
     |   Member Getters   |
     ---------------------*/
     inline std::shared_ptr<Bodies> get_bodies() { return bodies; }
-    inline std::vector<sf::RectangleShape*> get_bounding_boxes() { return bounding_boxes; }
-    inline sf::VertexArray* get_bounding_rectangles() const { return tree->get_bounding_rectangles(); };
+    inline const std::vector<Vec2T<float>>& get_bounding_lines() const { return tree->get_bounding_lines(); };
 
     /*--------------------
     | Simulation Settings |
     ---------------------*/
     void reset_simulation();
 
+    // the bodies are copied right away and written in the background, the next step does not wait for the disk
+    void save_checkpoint();
+    inline void wait_for_checkpoint() { checkpoint_writer.wait(); }
+
+    // starts or stops recording the trajectory
+    void toggle_recording();
+    inline TrajectoryRecorder& get_recorder() { return recorder; }
+
+    // replaces the bodies, settings and step count with the ones of the checkpoint, false if it could not be read
+    bool load_checkpoint(const std::string& path);
+
     inline void increase_G() { this->G *= 2; }
     inline void decrease_G() { this->G = std::max(0.0, this->G * 0.5); }
 
@@ -84,11 +203,38 @@ public:
     inline void increase_dt() { this->dt += 0.05; }
     inline void decrease_dt() { this->dt = std::max(0.05, this->dt - 0.05); }
 
+    // 0 lets the tree tune the leaf capacity on its own
+    inline void set_leaf_capacity(unsigned leaf_capacity)
+    {
+        if ( leaf_capacity != 0 ) tree->set_leaf_capacity(leaf_capacity);
+        tree->set_auto_tune_leaf_capacity(leaf_capacity == 0);
+    }
+
+    void set_force_method(enum ForceMethod force_method);
+    inline void set_refit(bool refit) { tree->set_refit(refit); }
+    inline void set_integrator(enum Integrator integrator) { bodies->integrator = integrator; }
+
+    // 0 moves every body with dt, otherwise bodies use dt / 2^level for levels up to max_time_level
+    inline void set_max_time_level(unsigned max_time_level) { bodies->set_max_time_level(max_time_level); }
+    inline void set_time_step_accuracy(double accuracy) { bodies->time_step_accuracy = accuracy; }
+    inline void set_collisions(bool collisions) { this->collisions = collisions; }
+    inline void set_checkpoint_path(const std::string& checkpoint_path) { this->checkpoint_path = checkpoint_path; }
+    inline void set_checkpoint_interval(unsigned checkpoint_interval) { this->checkpoint_interval = checkpoint_interval; }
+    inline void set_record_path(const std::string& record_path) { this->record_path = record_path; }
+    inline void set_record_interval(unsigned record_interval) { this->record_interval = std::max(1u, record_interval); }
+    inline void set_time_rate(double time_rate) { this->time_rate = std::max(0.0, time_rate); }
+    inline void set_max_catch_up_steps(unsigned max_catch_up_steps) { this->max_catch_up_steps = std::max(1u, max_catch_up_steps); }
+    inline void increase_time_rate() { time_rate = time_rate > 0.0 ? time_rate * 2.0 : DEFAULT_TIME_RATE; }
+    inline void decrease_time_rate() { time_rate *= 0.5; }
+    inline void set_multipole_order(unsigned order) { fast_multipole->set_order(order); }
+    inline unsigned get_multipole_order() const { return fast_multipole->get_order(); }
+
     inline long get_step() const { return steps; }
 
     inline double get_G() const { return G; }
     inline double get_theta() const { return theta; }
     inline double get_dt() const { return dt; }
+    inline unsigned get_leaf_capacity() const { return tree->get_leaf_capacity(); }
 
     inline Vec2 get_center_of_mass() const { return tree->get_center_of_mass(); }
     inline void get_quadtree_size(double& x, double& y, double& width, double& height) const
@@ -109,6 +255,15 @@ public:
     inline void toggle_draw_vectors() { draw_vectors = !draw_vectors; }
     inline void toggle_draw_quadtree() { draw_quadtree = !draw_quadtree; }
     inline void toggle_verbose_info() { toggle_verbose = !toggle_verbose; }
+    inline void toggle_load_balancing() { tree->set_load_balancing(!tree->get_load_balancing()); }
+    inline void toggle_force_method() { set_force_method(force_method == BARNES_HUT ? FAST_MULTIPOLE : BARNES_HUT); }
+    inline void toggle_refit() { tree->set_refit(!tree->get_refit()); }
+    inline void toggle_collisions() { collisions = !collisions; }
+    inline void toggle_fixed_timestep() { time_rate = time_rate > 0.0 ? 0.0 : DEFAULT_TIME_RATE; }
+    inline void toggle_block_timesteps() { set_max_time_level(bodies->max_time_level > 0 ? 0 : BLOCK_TIME_LEVELS); }
+    inline void toggle_integrator() { set_integrator(bodies->integrator == LEAPFROG_KDK ? VELOCITY_VERLET : LEAPFROG_KDK); }
+    inline void toggle_quadrupole() { tree->set_quadrupole(!tree->get_quadrupole()); }
+    inline void toggle_auto_tune_leaf_capacity() { tree->set_auto_tune_leaf_capacity(!tree->get_auto_tune_leaf_capacity()); }
 
     /*--------------------
     |   Toggle Getters   |
@@ -117,21 +272,45 @@ public:
     inline bool get_toggle_draw_vectors() const { return draw_vectors; }
     inline bool get_toggle_draw_quadtree() const { return draw_quadtree; }
     inline bool get_toggle_debug() const { return debug; }
+    inline bool get_toggle_load_balancing() const { return tree->get_load_balancing(); }
+    inline enum ForceMethod get_force_method() const { return force_method; }
+    inline bool get_toggle_refit() const { return tree->get_refit(); }
+    inline enum Integrator get_integrator() const { return bodies->integrator; }
+    inline unsigned get_max_time_level() const { return bodies->max_time_level; }
+    inline bool get_toggle_collisions() const { return collisions; }
+    inline double get_time_rate() const { return time_rate; }
+    inline double get_simulated_time() const { return simulated_time; }
+    inline double get_dropped_time() const { return dropped_time; }
+    inline bool get_toggle_quadrupole() const { return tree->get_quadrupole(); }
+    inline bool get_auto_tune_leaf_capacity() const { return tree->get_auto_tune_leaf_capacity(); }
 
     /*--------------------
     |  Sim Stat Getters  |
     ---------------------*/
     double get_current_ratio_worst_case();
     double get_current_ratio_best_case();
-    double get_average_ratio_best_case();
-    double get_average_ratio_worst_case();
+    inline double get_average_ratio_best_case() const { return average_ratio_best_case; }
+    inline double get_average_ratio_worst_case() const { return average_ratio_worst_case; }
 
-    inline double get_fps() const { return 1e6 * 1.0 / this->total_frame_time; }
     inline double get_num_particles() const { return static_cast<double>(bodies->get_size()); }
+    inline unsigned get_num_threads() const { return thread_pool->get_num_threads(); }
+    inline ThreadPool& get_thread_pool() { return *thread_pool; }
 
     inline double get_elapsed_time_physics() const { return this->elapsed_time_physics / 1000; }
-    inline double get_elapsed_time_graphics() const { return this->elapsed_time_graphics / 1000; }
-    inline double get_total_frame_time() const { return this->total_frame_time / 1000; }
+
+    double get_load_imbalance() const;
+    void print_thread_times() const;
+
+    inline unsigned get_last_merges() const { return last_merges; }
+    inline unsigned long get_total_merges() const { return total_merges; }
+    inline double get_active_fraction() const { return active_fraction; }
+    inline double get_forces_per_body() const { return forces_per_body; }
+
+    // refits and full rebuilds of the tree so far, and whether the last step was a refit
+    inline unsigned long get_refit_count() const { return tree->get_refit_count(); }
+    inline unsigned long get_rebuild_count() const { return tree->get_rebuild_count(); }
+    inline bool get_last_was_refit() const { return tree->get_last_was_refit(); }
+    inline double get_tree_time() const { return tree->get_build_time(); }
 
     inline double get_interactions_per_frame() const { return static_cast<double>(this->calculations_per_frame); }
     inline double get_total_interactions() const { return static_cast<double>(this->total_calculations); }
@@ -0,0 +1,76 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "Bodies.h"
+#include "Vec2.h"
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+/*
+everything the viewer draws of one step, copied out of the simulation by the physics thread.
+the render thread only ever reads snapshots, never the bodies or the tree, so the two threads share no mutable state.
+*/
+struct Snapshot {
+    std::vector<Vec2T<float>> positions;
+    std::vector<Vec2T<float>> previous_positions;   // of the snapshot before, only filled with a fixed time rate
+    std::vector<uint8_t> shades;            // |a| mapped to [0, 255] between the lowest and the highest of the step
+    std::vector<Vec2T<float>> velocities;   // only filled while the vectors are drawn
+    std::vector<Vec2T<float>> bound_lines;  // only filled while the quadtree is drawn, two points per line
+
+    // the viewer draws between previous_positions and positions, one snapshot behind: interval simulated time lies
+    // between the two, and time_rate of it passes per second since published_at
+    std::chrono::steady_clock::time_point published_at;
+    double interval = 0.0;
+    double time_rate = 0.0;
+
+    Vec2T<double> center_of_mass;
+    Vec2T<double> top_left, bottom_right;   // of the tree
+
+    // toggles
+    bool paused = true;
+    bool draw_quadtree = false;
+    bool draw_vectors = false;
+    bool debug = false;
+    bool load_balancing = true;
+    bool quadrupole = false;
+    bool refit = false;
+    bool auto_tune_leaf_capacity = false;
+    bool collisions = false;
+
+    // settings
+    double G = 0.0, theta = 0.0, dt = 0.0;
+    bool fast_multipole = false;
+    unsigned multipole_order = 0;
+    enum Integrator integrator = LEAPFROG_KDK;
+    unsigned max_time_level = 0;
+    unsigned leaf_capacity = 0;
+    unsigned num_threads = 0;
+
+    // set by the TrajectoryPlayer, frame of frame_count of the recording
+    bool playback = false;
+    unsigned long frame = 0, frame_count = 0;
+
+    // stats of the last step
+    long step = 0;
+    double simulated_time = 0.0;
+    double dropped_time = 0.0;              // simulated time skipped because the steps could not keep up
+    unsigned max_catch_up_steps = 0;
+    unsigned num_bodies = 0;
+    unsigned long total_merges = 0;
+    bool recording = false;
+    unsigned long recorded_frames = 0, dropped_frames = 0;
+    unsigned long recorded_bytes = 0;
+    double physics_time = 0.0;              // ms
+    double tree_time = 0.0;                 // ms
+    bool last_was_refit = false;
+    unsigned long refit_count = 0, rebuild_count = 0;
+    double load_imbalance = 1.0;
+    double active_fraction = 1.0, forces_per_body = 1.0;
+    double interactions_per_frame = 0.0, total_interactions = 0.0;
+    double ratio_best_case = 0.0, average_ratio_best_case = 0.0;
+    double ratio_worst_case = 0.0, average_ratio_worst_case = 0.0;
+};
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,98 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/*
+long lived worker threads that are woken up for every parallel section.
+the calling thread always takes part as thread 0, so a pool of n threads only spawns n-1 workers,
+and nothing is allocated or spawned after construction.
+
+jobs are passed as a plain function pointer + context, a std::function could allocate on every call.
+parallel sections must not be nested.
+*/
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable start_condition;
+    std::condition_variable done_condition;
+
+    uint64_t generation;
+    unsigned remaining;
+    bool stopping;
+
+    void (*job)(void* context, unsigned thread_index);
+    void* job_context;
+
+    unsigned num_threads;
+
+    void worker_loop(unsigned thread_index);
+    void dispatch(void (*function)(void*, unsigned), void* context);
+
+    static void pin_to_core(std::thread::native_handle_type handle, unsigned core);
+
+public:
+    // num_threads = 0 uses all hardware threads, pinning is only supported on linux
+    ThreadPool(unsigned num_threads = 0, bool pin_threads = false);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    inline unsigned get_num_threads() const { return num_threads; }
+
+    // calls function(thread_index) once on every thread and returns when all of them are done
+    template <typename Function>
+    void run(Function&& function)
+    {
+        if ( num_threads == 1 )
+        {
+            function(0u);
+            return;
+        }
+
+        using FunctionType = std::remove_reference_t<Function>;
+
+        dispatch([](void* context, unsigned thread_index)
+            {
+                (*static_cast<FunctionType*>(context))(thread_index);
+            }, const_cast<void*>(static_cast<const void*>(&function)));
+    }
+
+    // splits [begin, end) into one contiguous chunk per thread and calls function(start, end, thread_index)
+    // ranges shorter than min_per_thread per thread use fewer threads, tiny ones run inline
+    template <typename Function>
+    void parallel_for(unsigned begin, unsigned end, Function&& function, unsigned min_per_thread = 1024)
+    {
+        const unsigned count = end > begin ? end - begin : 0;
+        const unsigned chunks = std::max(1u, std::min(num_threads, count / std::max(1u, min_per_thread)));
+
+        if ( chunks == 1 )
+        {
+            function(begin, end, 0u);
+            return;
+        }
+
+        run([&function, begin, count, chunks](unsigned thread_index)
+            {
+                if ( thread_index >= chunks )
+                {
+                    return;
+                }
+
+                const unsigned start = begin + static_cast<unsigned>(static_cast<uint64_t>(count) * thread_index / chunks);
+                const unsigned stop = begin + static_cast<unsigned>(static_cast<uint64_t>(count) * (thread_index + 1) / chunks);
+                function(start, stop, thread_index);
+            });
+    }
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,234 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include "Bodies.h"
+#include "Vec2.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+recorded trajectory of a run, a stream of compressed frames.
+
+layout (native byte order):
+    TrajectoryHeader
+    TrajectoryFrameHeader, compressed_size bytes of payload      once per recorded step
+
+positions are quantized to position_bits relative to the box of their frame (the particle area of the step),
+velocities to velocity_bits relative to the largest component of their frame. every body then stores the
+difference of its quantized values to the frame before, zigzag and varint encoded: x of every body, then y, vx, vy.
+keyframes store the differences to zero and additionally mass and radius as floats, so they decode on their own.
+a keyframe is written every keyframe_interval frames and whenever the number of bodies changed (merges).
+the payload is that byte stream compressed with the lz codec below, or stored as it is if that does not make it smaller.
+*/
+struct TrajectoryHeader {
+    static constexpr char MAGIC[8] = { 'G', 'R', 'A', 'V', 'T', 'R', 'A', 'J' };
+    static constexpr uint32_t VERSION = 1;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t position_bits;
+    uint32_t velocity_bits;
+    uint32_t keyframe_interval;
+    uint32_t record_interval;   // steps between two frames
+    uint32_t reserved;
+    double G, dt;
+};
+
+struct TrajectoryFrameHeader {
+    static constexpr uint32_t MAGIC = 0x4d415246;   // "FRAM"
+    static constexpr uint32_t KEYFRAME = 1;
+    static constexpr uint32_t STORED = 2;           // payload is not compressed
+
+    uint32_t magic;
+    uint32_t flags;
+    int64_t step;
+    double simulated_time;
+    uint32_t num_bodies;
+    uint32_t raw_size;
+    uint64_t compressed_size;
+    double min_x, min_y, max_x, max_y;
+    double max_velocity;
+};
+
+// one step of the bodies, what the recorder copies and what the decoder fills
+struct TrajectoryFrame {
+    long step = 0;
+    double simulated_time = 0.0;
+    Vec2T<double> top_left, bottom_right;
+    std::vector<real> x, y, vx, vy, mass, radius;
+
+    inline unsigned size() const { return x.size(); }
+    void resize(unsigned n);
+};
+
+/*
+byte oriented lz77 in the spirit of lz4: sequences of literals followed by a match of at least 4 bytes
+up to 64 KiB back, found through a hash table of the last position of every 4 byte prefix.
+no entropy coding, it is there to squeeze out the runs the delta encoding leaves behind at a few hundred MB/s.
+*/
+class LzCodec {
+private:
+    static constexpr unsigned HASH_BITS = 16;
+    static constexpr unsigned MIN_MATCH = 4;
+    static constexpr unsigned MAX_OFFSET = 65535;
+
+    std::vector<uint32_t> hash_table;
+
+public:
+    // out is resized to the compressed size
+    void compress(const uint8_t* in, std::size_t size, std::vector<uint8_t>& out);
+
+    // false if the input is corrupt or does not decompress to exactly out_size bytes
+    static bool decompress(const uint8_t* in, std::size_t size, uint8_t* out, std::size_t out_size);
+};
+
+/*
+quantization and delta encoding of frames, the codec remembers the quantized values of the last frame.
+frames have to be decoded in the order they were encoded, starting at a keyframe.
+*/
+class TrajectoryCodec {
+private:
+    unsigned position_bits = 20;
+    unsigned velocity_bits = 16;
+
+    std::vector<uint32_t> previous[4];  // quantized x, y, vx, vy of the last frame
+    std::vector<real> mass, radius;     // of the last keyframe
+    std::vector<uint8_t> raw;
+    LzCodec lz;
+
+public:
+    static constexpr unsigned MIN_BITS = 8;
+    static constexpr unsigned MAX_BITS = 24;
+
+    void set_bits(unsigned position_bits, unsigned velocity_bits);
+
+    // fills everything of the header except the magic, out holds the payload
+    void encode(const TrajectoryFrame& frame, bool keyframe, TrajectoryFrameHeader& header, std::vector<uint8_t>& out);
+
+    // false if the payload is corrupt, or it is a delta frame and the last decoded frame had a different size.
+    // without a frame only the state is advanced, for frames that are skipped over
+    bool decode(const TrajectoryFrameHeader& header, const uint8_t* payload, TrajectoryFrame* frame);
+};
+
+/*
+records frames on a background thread. record() only copies the bodies into a free slot of a ring of frames
+and returns, quantizing, compressing and writing happen on the thread. a full ring drops the frame instead of waiting,
+so the physics thread never blocks on the recorder, however slow the disk or the bandwidth limit is.
+the slots grow to the number of bodies once and are reused from then on.
+*/
+class TrajectoryRecorder {
+private:
+    static constexpr unsigned RING_SIZE = 8;
+
+    FILE* file = nullptr;
+    std::thread thread;
+    std::atomic<bool> running { false };
+
+    // single producer (record) single consumer (the thread), head - tail slots are filled
+    std::vector<TrajectoryFrame> ring;
+    std::atomic<uint64_t> head { 0 }, tail { 0 };
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+
+    TrajectoryCodec codec;
+    std::vector<uint8_t> payload;
+
+    unsigned position_bits = 20;
+    unsigned velocity_bits = 16;
+    unsigned keyframe_interval = 16;
+    std::atomic<double> bandwidth { 0.0 };  // bytes per second written at most, 0 = unlimited
+
+    std::atomic<unsigned long> recorded_frames { 0 }, dropped_frames { 0 };
+    std::atomic<unsigned long> written_bytes { 0 }, raw_bytes { 0 };
+
+    void write_frames();
+
+public:
+    TrajectoryRecorder() = default;
+    ~TrajectoryRecorder();
+
+    TrajectoryRecorder(const TrajectoryRecorder&) = delete;
+    TrajectoryRecorder& operator=(const TrajectoryRecorder&) = delete;
+
+    // false if the file could not be created
+    bool start(const std::string& path, double G, double dt, unsigned record_interval);
+
+    // writes the frames still in the ring and closes the file
+    void stop();
+    inline bool is_recording() const { return running; }
+
+    // false if the frame was dropped because the ring is full
+    bool record(const Bodies& bodies, long step, double simulated_time, Vec2 top_left, Vec2 bottom_right);
+
+    // the bits and the keyframe interval take effect with the next start, the bandwidth right away
+    inline void set_bits(unsigned position_bits, unsigned velocity_bits) { this->position_bits = position_bits; this->velocity_bits = velocity_bits; }
+    inline void set_keyframe_interval(unsigned keyframe_interval) { this->keyframe_interval = std::max(1u, keyframe_interval); }
+    inline void set_bandwidth(double bytes_per_second) { bandwidth = std::max(0.0, bytes_per_second); }
+
+    inline unsigned long get_recorded_frames() const { return recorded_frames; }
+    inline unsigned long get_dropped_frames() const { return dropped_frames; }
+    inline unsigned long get_written_bytes() const { return written_bytes; }
+    inline unsigned long get_raw_bytes() const { return raw_bytes; }    // of the frames as real arrays
+};
+
+/*
+reads a recorded trajectory through a read only mapping of the file, the frames are indexed once when it is opened.
+frames decode fastest in order, any other frame decodes from the keyframe before it.
+after every read the pages of the next few frames are requested ahead (madvise), so playback
+does not stall on the disk once the frames it needs are further along in the file.
+*/
+class TrajectoryReader {
+private:
+    struct FrameEntry {
+        uint64_t offset;    // of the frame header
+        int64_t step;
+        double simulated_time;
+        uint32_t keyframe;  // index of the keyframe this frame decodes from
+    };
+
+    static constexpr unsigned PREFETCH_FRAMES = 8;
+
+    const uint8_t* data = nullptr;
+    uint64_t file_size = 0;
+
+    TrajectoryHeader header {};
+    std::vector<FrameEntry> frames;
+
+    TrajectoryCodec codec;
+    long decoded = -1;      // index of the frame the codec decoded last
+
+    void prefetch(std::size_t index) const;
+
+public:
+    TrajectoryReader() = default;
+    ~TrajectoryReader();
+
+    TrajectoryReader(const TrajectoryReader&) = delete;
+    TrajectoryReader& operator=(const TrajectoryReader&) = delete;
+
+    // false if the file is missing or not a trajectory. a recording that was cut off keeps the frames that are complete
+    bool open(const std::string& path);
+    void close();
+
+    // decodes the frame, false if it is out of range or corrupt
+    bool read(std::size_t index, TrajectoryFrame& frame);
+
+    inline const TrajectoryHeader& get_header() const { return header; }
+    inline std::size_t get_frame_count() const { return frames.size(); }
+    inline long get_step(std::size_t index) const { return frames[index].step; }
+    inline std::size_t get_keyframe(std::size_t index) const { return frames[index].keyframe; }
+    inline double get_simulated_time(std::size_t index) const { return frames[index].simulated_time; }
+
+    // the last frame at or before the simulated time, 0 if there is none
+    std::size_t find_frame(double simulated_time) const;
+};
+
+#endif // TRAJECTORY_H
@@ -0,0 +1,99 @@
+#ifndef TRAJECTORY_PLAYER_H
+#define TRAJECTORY_PLAYER_H
+
+#include "Snapshot.h"
+#include "Trajectory.h"
+#include "TripleBuffer.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+plays a recorded trajectory back without any physics, in place of the SimulationManager: advance() runs on its own thread,
+decodes the frame that is due at the playback speed and publishes it as a snapshot, the viewer draws it like a live run.
+frames the decoder can not keep up with are skipped, and the viewer interpolates between the frames it gets,
+so the display keeps its frame rate however large the recording is.
+
+the colors come from |v|, the recording has no accelerations.
+*/
+class TrajectoryPlayer {
+public:
+    using Command = void (TrajectoryPlayer::*)();
+
+private:
+    static constexpr double PAUSED_WAIT = 0.002;    // s
+    static constexpr double MAX_WAIT = 0.002;       // s, so commands and seeks are picked up quickly
+
+    TrajectoryReader reader;
+    TrajectoryFrame frame;
+    std::size_t current = 0;
+    bool loaded = false;
+
+    bool paused = false;
+    bool draw_vectors = false;
+    bool debug = true;
+
+    // simulated time of the recording that passes per second, and where the playback is
+    double time_rate = 0.0;
+    double play_time = 0.0;
+    std::chrono::steady_clock::time_point last_advance;
+
+    // fraction of the recording to jump to, set by any thread, negative while nothing is requested
+    std::atomic<double> requested_seek { -1.0 };
+    std::atomic<bool> seek_keyframe { false };
+
+    std::mutex command_mutex;
+    std::vector<Command> pending_commands;
+    std::vector<Command> running_commands;
+
+    TripleBuffer<Snapshot> snapshots;
+    std::vector<Vec2T<float>> published_positions;
+    double published_time = 0.0;    // of the frame in published_positions
+    bool snapshot_dirty = true;
+    bool continuous = false;        // whether the next frame is the one after the published one in playback order
+
+    void run_commands();
+    void load_frame(std::size_t index);
+    void publish_snapshot();
+
+public:
+    // false if the file could not be read or has no frames
+    bool open(const std::string& path);
+
+    // plays what is due, returns the seconds until the next frame is
+    double advance();
+
+    // runs the command on the playback thread with the next advance()
+    void post(Command command);
+
+    // any thread, in [0, 1] of the recording. landing on the keyframe before only decodes one frame, for scrubbing
+    inline void seek(double fraction, bool keyframe_only = false)
+    {
+        seek_keyframe = keyframe_only;
+        requested_seek = std::clamp(fraction, 0.0, 1.0);
+    }
+
+    const Snapshot& latest_snapshot();
+
+    // commands
+    inline void toggle_pause() { paused = !paused; snapshot_dirty = true; }
+    inline void toggle_draw_vectors() { draw_vectors = !draw_vectors; snapshot_dirty = true; }
+    inline void toggle_debug_info() { debug = !debug; snapshot_dirty = true; }
+    inline void faster() { time_rate *= 2.0; snapshot_dirty = true; }
+    inline void slower() { time_rate *= 0.5; snapshot_dirty = true; }
+    void step_forward();
+    void step_backward();
+    void skip_forward();
+    void skip_backward();
+    void seek_start();
+    void seek_end();
+
+    inline std::size_t get_frame_count() const { return reader.get_frame_count(); }
+    inline std::size_t get_frame() const { return current; }
+    inline double get_time_rate() const { return time_rate; }
+};
+
+#endif // TRAJECTORY_PLAYER_H
@@ -0,0 +1,46 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+/*
+lock-free handoff of the newest value from one writer thread to one reader thread.
+the writer fills its back buffer and publishes it, the reader picks up whatever was published last.
+neither side ever waits for the other, and the three buffers are reused so nothing is allocated once their vectors have grown.
+*/
+template <typename T>
+class TripleBuffer {
+private:
+    // the low bits hold the index of the middle buffer, FRESH is set while the reader has not taken it yet
+    static constexpr uint8_t INDEX_MASK = 3;
+    static constexpr uint8_t FRESH = 4;
+
+    T buffers[3];
+    std::atomic<uint8_t> middle { 1 };
+
+    uint8_t back = 0;   // only touched by the writer
+    uint8_t front = 2;  // only touched by the reader
+
+public:
+    // writer side
+    inline T& write_buffer() { return buffers[back]; }
+    inline void publish()
+    {
+        back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // reader side, swaps in the newest published value. false if nothing was published since the last call
+    inline bool update()
+    {
+        if ( (middle.load(std::memory_order_relaxed) & FRESH) == 0 )
+            return false;
+
+        front = middle.exchange(front, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+
+    inline const T& read_buffer() const { return buffers[front]; }
+};
+
+#endif // TRIPLE_BUFFER_H
@@ -5,128 +5,136 @@
 #include <cmath>
 #include <iostream> 
 
-class Vec2 {
+#include "Real.h"
+
+template <typename T>
+class Vec2T {
 public:
-    double x, y;
+    T x, y;
 
-    Vec2() : x(0.0), y(0.0) {}
+    Vec2T() : x(0), y(0) {}
 
-    Vec2(double x, double y) : x(x), y(y) {}
+    Vec2T(T x, T y) : x(x), y(y) {}
 
-    Vec2(const Vec2& other) : x(other.x), y(other.y) {}
+    // between precisions only on request
+    template <typename U>
+    explicit Vec2T(const Vec2T<U>& other) : x(static_cast<T>(other.x)), y(static_cast<T>(other.y)) {}
 
-    friend std::ostream& operator<<(std::ostream& os, const Vec2& vec)
+    friend std::ostream& operator<<(std::ostream& os, const Vec2T& vec)
     {
         os << "(" << vec.x << ", " << vec.y << ")";
         return os;
     }
 
-    inline double get_x() const { return x; }
-    inline double get_y() const { return y; }
+    inline T get_x() const { return x; }
+    inline T get_y() const { return y; }
 
-    inline void set_x(double x) { this->x = x; }
-    inline void set_y(double y) { this->y = y; }
+    inline void set_x(T x) { this->x = x; }
+    inline void set_y(T y) { this->y = y; }
 
-    inline Vec2 operator+(const Vec2& other) const
+    inline Vec2T operator+(const Vec2T& other) const
     {
-        return Vec2(x + other.x, y + other.y);
+        return Vec2T(x + other.x, y + other.y);
     }
 
-    inline Vec2 operator-(const Vec2& other) const
+    inline Vec2T operator-(const Vec2T& other) const
     {
-        return Vec2(x - other.x, y - other.y);
+        return Vec2T(x - other.x, y - other.y);
     }
 
-    inline Vec2 operator-() const
+    inline Vec2T operator-() const
     {
-        return Vec2(-x, -y);
+        return Vec2T(-x, -y);
     }
 
-    inline Vec2 operator*(double scalar) const
+    inline Vec2T operator*(T scalar) const
     {
-        return Vec2(x * scalar, y * scalar);
+        return Vec2T(x * scalar, y * scalar);
     }
 
-    inline Vec2 operator/(double scalar) const
+    inline Vec2T operator/(T scalar) const
     {
-        return Vec2(x / scalar, y / scalar);
+        return Vec2T(x / scalar, y / scalar);
     }
 
-    inline Vec2& operator+=(const Vec2& other)
+    inline Vec2T& operator+=(const Vec2T& other)
     {
         x += other.x;
         y += other.y;
         return *this;
     }
 
-    inline Vec2& operator-=(const Vec2& other)
+    inline Vec2T& operator-=(const Vec2T& other)
     {
         x -= other.x;
         y -= other.y;
         return *this;
     }
 
-    inline Vec2& operator*=(double scalar)
+    inline Vec2T& operator*=(T scalar)
     {
         x *= scalar;
         y *= scalar;
         return *this;
     }
 
-    inline Vec2& operator/=(double scalar)
+    inline Vec2T& operator/=(T scalar)
     {
         x /= scalar;
         y /= scalar;
         return *this;
     }
 
-    inline bool operator==(const Vec2& other) const
+    inline bool operator==(const Vec2T& other) const
     {
         return x == other.x && y == other.y;
     }
 
-    inline bool operator!=(const Vec2& other) const
+    inline bool operator!=(const Vec2T& other) const
     {
         return !(*this == other);
     }
 
-    inline double dist(const Vec2& other) const
+    inline T dist(const Vec2T& other) const
     {
         return (*this - other).length();
     }
 
-    inline double dot(const Vec2& other) const
+    inline T dot(const Vec2T& other) const
     {
         return x * other.x + y * other.y;
     }
 
-    inline Vec2 cross(const Vec2& other) const
+    inline Vec2T cross(const Vec2T& other) const
     {
-        return Vec2(x * other.y - y * other.x, x * other.y - y * other.x);
+        return Vec2T(x * other.y - y * other.x, x * other.y - y * other.x);
     }
 
-    inline double length() const
+    inline T length() const
     {
         return std::hypot(x, y);
     }
 
-    inline double squared_length() const
+    inline T squared_length() const
     {
         return x * x + y * y;
     }
 
-    inline Vec2 normalize() const
+    inline Vec2T normalize() const
     {
-        double len = length();
-        return Vec2(x / len, y / len);
+        T len = length();
+        return Vec2T(x / len, y / len);
     }
 
-    inline Vec2 rotate(double angle) const
+    inline Vec2T rotate(T angle) const
     {
-        double c = std::cos(angle);
-        double s = std::sin(angle);
-        return Vec2(x * c - y * s, x * s + y * c);
+        T c = std::cos(angle);
+        T s = std::sin(angle);
+        return Vec2T(x * c - y * s, x * s + y * c);
     }
 };
 
+// the simulation works in its own precision, see Real.h
+using Vec2 = Vec2T<real>;
+
 #endif
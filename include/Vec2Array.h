@@ -0,0 +1,96 @@
+#ifndef VEC2_ARRAY_H
+#define VEC2_ARRAY_H
+
+#include "AlignedAllocator.h"
+#include "Vec2.h"
+
+/*
+the bodies store x and y in separate arrays, these two classes let the rest of the code keep
+writing bodies->pos[i], bodies->pos[i].x or bodies->vel[i] += ... as if it was a std::vector<Vec2>.
+
+Vec2Ref behaves like a Vec2& that points into both arrays, Vec2Array is a view that hands them out.
+hot loops should use the component arrays directly.
+*/
+class Vec2Ref {
+public:
+    real& x;
+    real& y;
+
+    Vec2Ref(real& x, real& y) : x(x), y(y) {}
+
+    inline operator Vec2() const { return Vec2(x, y); }
+
+    // assignment writes through to the arrays
+    inline Vec2Ref& operator=(const Vec2& other)
+    {
+        x = other.x;
+        y = other.y;
+        return *this;
+    }
+
+    inline Vec2Ref& operator=(const Vec2Ref& other)
+    {
+        x = other.x;
+        y = other.y;
+        return *this;
+    }
+
+    inline Vec2Ref& operator+=(const Vec2& other)
+    {
+        x += other.x;
+        y += other.y;
+        return *this;
+    }
+
+    inline Vec2Ref& operator-=(const Vec2& other)
+    {
+        x -= other.x;
+        y -= other.y;
+        return *this;
+    }
+
+    inline Vec2Ref& operator*=(real scalar)
+    {
+        x *= scalar;
+        y *= scalar;
+        return *this;
+    }
+
+    inline Vec2Ref& operator/=(real scalar)
+    {
+        x /= scalar;
+        y /= scalar;
+        return *this;
+    }
+
+    inline Vec2 operator+(const Vec2& other) const { return Vec2(x + other.x, y + other.y); }
+    inline Vec2 operator-(const Vec2& other) const { return Vec2(x - other.x, y - other.y); }
+    inline Vec2 operator-() const { return Vec2(-x, -y); }
+    inline Vec2 operator*(real scalar) const { return Vec2(x * scalar, y * scalar); }
+    inline Vec2 operator/(real scalar) const { return Vec2(x / scalar, y / scalar); }
+
+    inline real dist(const Vec2& other) const { return Vec2(x, y).dist(other); }
+    inline real dot(const Vec2& other) const { return x * other.x + y * other.y; }
+    inline real length() const { return std::hypot(x, y); }
+    inline real squared_length() const { return x * x + y * y; }
+    inline Vec2 normalize() const { return Vec2(x, y).normalize(); }
+
+    friend std::ostream& operator<<(std::ostream& os, const Vec2Ref& vec)
+    {
+        return os << Vec2(vec.x, vec.y);
+    }
+};
+
+class Vec2Array {
+private:
+    // the vectors themselves, not their data, so the view survives a reallocation
+    AlignedVector<real>* x_data;
+    AlignedVector<real>* y_data;
+
+public:
+    Vec2Array(AlignedVector<real>& x, AlignedVector<real>& y) : x_data(&x), y_data(&y) {}
+
+    inline Vec2Ref operator[](std::size_t index) const { return Vec2Ref((*x_data)[index], (*y_data)[index]); }
+};
+
+#endif // VEC2_ARRAY_H
@@ -7,7 +7,10 @@ class SimulationManager;
 #include <string>
 #include <iostream>
 
+#include "FrameExporter.h"
+#include "Rasterizer.h"
 #include "SimulationManager.h"
+#include "TrajectoryPlayer.h"
 
 class Window {
 private:
@@ -17,40 +20,81 @@ private:
 
     double zoomFactor;
     bool isDragging;
+    bool isScrubbing;
     bool toggle_tracking;
     sf::Vector2i lastMousePos;
 
     sf::Font font;
 
     sf::VertexArray calc_per_frame;
+    sf::VertexArray quadtree_lines;
 
+    // bodies and velocity vectors are written on the vertex pool into vectors that never shrink, then streamed
+    // into buffers that only grow, so a frame allocates nothing once the body count has been reached
+    static constexpr unsigned MAX_VERTEX_THREADS = 4;   // the physics has the other cores
+    ThreadPool* vertex_pool;
+    std::vector<sf::Vertex> star_vertices;
+    std::vector<sf::Vertex> velocity_vertices;
+    sf::VertexBuffer stars;
+    sf::VertexBuffer velocity_lines;
+
+    // color of every shade of a snapshot, from low to high acceleration
+    sf::Color shade_colors[256];
+
+    // exactly one of them is set, a live simulation or the playback of a recording
     std::shared_ptr<SimulationManager> simulation_manager;
-    std::shared_ptr<Bodies> bodies;
+    std::shared_ptr<TrajectoryPlayer> player;
+
+    // the newest snapshot of the physics thread, the window never touches the simulation directly
+    const Snapshot* snapshot;
+
+    // bodies, vectors and the quadtree are drawn to target: the window, or the export texture while a frame is exported
+    sf::RenderTarget* target;
+
+    // every new snapshot is rendered offscreen at the size of the exporter and handed to its encoder threads
+    std::shared_ptr<FrameExporter> exporter;
+    sf::RenderTexture* export_texture;
+    bool exporting;
+    std::chrono::steady_clock::time_point exported_at;  // published_at of the last exported snapshot
+    double export_time; // ms, render thread only
+
+    double draw_time;   // ms
+    double frame_time;  // ms, including the wait for vsync
 
     int width, height;
 
     void draw_everything();
+    void draw_vertices(sf::VertexBuffer& buffer, const std::vector<sf::Vertex>& vertices, sf::PrimitiveType type);
     void draw_bodies();
     void draw_velocity_vectors();
     void draw_quadtree_bounds();
+    void draw_timeline();
     void draw_ui();
+    void export_frame();
 
     void handle_events();
     void settings_events(sf::Event& event);
+    void playback_events(sf::Event& event);
     void handle_mouse_wheel(const sf::Event::MouseWheelScrollEvent& event);
     void handle_mouse_press(const sf::Event::MouseButtonEvent& event);
     void handle_mouse_release(const sf::Event::MouseButtonEvent& event);
     void handle_mouse_move(const sf::Event::MouseMoveEvent& event);
 
+    void create(const char* title);
     void reset_view();
-
-    void store_png(const std::string& filename);
+    void scrub(int x, bool keyframe_only);
 
 public:
 
     Window(int width, int height, const char* title, std::shared_ptr<SimulationManager> simulation_manager);
+    Window(int width, int height, const char* title, std::shared_ptr<TrajectoryPlayer> player);
     ~Window();
 
+    // starts exporting right away, E pauses and resumes it
+    void set_exporter(std::shared_ptr<FrameExporter> exporter);
+
+    // steps the simulation (or the playback) on its own thread and draws the newest snapshot at vsync until the window is closed
+    void run();
     void update();
 
     bool is_open();
@@ -1,4 +1,7 @@
 #include "Bodies.h"
+#include "ForceKernel.h"
+#include <algorithm>
+#include <bit>
 #include <limits>
 #include <cmath>
 
@@ -6,18 +9,11 @@
 |               Constructor              |
 -----------------------------------------*/
 
-Bodies::Bodies(unsigned num_bodies)
+Bodies::Bodies(unsigned num_bodies) :
+    pos(x, y), vel(vx, vy), acc(ax, ay)
 {
     size = num_bodies;
-
-    pos.resize(num_bodies);
-    vel.resize(num_bodies);
-    acc.resize(num_bodies, Vec2(0.0, 0.0));
-
-    mass.resize(num_bodies, 0.0);
-    radius.resize(num_bodies, 0.0);
-
-    to_be_deleted.resize(num_bodies, false);
+    resize_arrays(num_bodies);
 }
 
 
@@ -30,49 +26,119 @@ unsigned Bodies::get_size() const
     return size;
 }
 
-double Bodies::get_lowest_density() const
+void Bodies::add_force(unsigned index, const Vec2& force)
 {
-    double lowest_density = std::numeric_limits<double>::max();
-    for ( unsigned i = 0; i < size; ++i )
-    {
-        lowest_density = std::min(lowest_density, this->acc[i].length());
-    }
+    acc[index] += force / mass[index];
+}
 
-    return lowest_density;
+void Bodies::reset_force(unsigned index)
+{
+    acc[index] = Vec2(0.0, 0.0);
 }
 
-double Bodies::get_highest_density() const
+
+/*----------------------------------------
+|            update/modify               |
+-----------------------------------------*/
+
+void Bodies::begin_step(double dt)
 {
-    double highest_density = std::numeric_limits<double>::min();
-    for ( unsigned i = 0; i < size; ++i )
+    begin_step(dt, 0, size);
+}
+
+void Bodies::begin_step(double dt, unsigned start, unsigned end)
+{
+    real* __restrict px = x.data();
+    real* __restrict py = y.data();
+    real* __restrict pvx = vx.data();
+    real* __restrict pvy = vy.data();
+    const real* __restrict pax = ax.data();
+    const real* __restrict pay = ay.data();
+
+    const real half_step = static_cast<real>(0.5 * dt);
+    const real step = static_cast<real>(dt);
+
+    if ( integrator == VELOCITY_VERLET )
     {
-        highest_density = std::max(highest_density, this->acc[i].length());
+        const real half_step_squared = static_cast<real>(0.5 * dt * dt);
+
+        for ( unsigned i = start; i < end; ++i )
+        {
+            px[i] += pvx[i] * step + pax[i] * half_step_squared;
+            py[i] += pvy[i] * step + pay[i] * half_step_squared;
+        }
+        return;
     }
 
-    return highest_density;
+    for ( unsigned i = start; i < end; ++i )
+    {
+        pvx[i] += pax[i] * half_step;
+        pvy[i] += pay[i] * half_step;
+        px[i] += pvx[i] * step;
+        py[i] += pvy[i] * step;
+    }
 }
 
-void Bodies::add_force(unsigned index, const Vec2& force)
+unsigned Bodies::kick_starting_bodies(double dt, unsigned start, unsigned end, unsigned& deepest_level)
 {
-    acc[index] += force / mass[index];
-}
+    real* __restrict pvx = vx.data();
+    real* __restrict pvy = vy.data();
+    const real* __restrict pax = ax.data();
+    const real* __restrict pay = ay.data();
+
+    // a body may only move to a longer step where that step starts: level l starts every 2^(max - l) substeps
+    const unsigned aligned = std::min(static_cast<unsigned>(std::countr_zero(substep)), max_time_level);
+    const unsigned lowest_level = max_time_level - aligned;
+    const double softening = std::sqrt(static_cast<double>(SOFTENING_SQUARED));
+    const double criterion = dt * dt / (time_step_accuracy * time_step_accuracy * softening);
+
+    unsigned started = 0;
+    unsigned deepest = 0;
+    for ( unsigned i = start; i < end; ++i )
+    {
+        if ( is_active(i) )
+        {
+            // (dt / dt_i)^2 = dt^2 |a| / (eta^2 eps), every level halves dt_i
+            const double ratio = criterion * std::hypot(static_cast<double>(pax[i]), static_cast<double>(pay[i]));
+            const unsigned wanted = ratio > 1.0 ? static_cast<unsigned>(std::ceil(0.5 * std::log2(ratio))) : 0;
+            time_level[i] = static_cast<uint8_t>(std::clamp(wanted, lowest_level, max_time_level));
+
+            const real body_half_step = static_cast<real>(std::ldexp(0.5 * dt, -static_cast<int>(time_level[i])));
+            pvx[i] += pax[i] * body_half_step;
+            pvy[i] += pay[i] * body_half_step;
+            ++started;
+        }
 
-void Bodies::reset_force(unsigned index)
-{
-    acc[index] = Vec2(0.0, 0.0);
+        deepest = std::max<unsigned>(deepest, time_level[i]);
+    }
+
+    deepest_level = deepest;
+    return started;
 }
 
+void Bodies::drift(double duration, unsigned start, unsigned end)
+{
+    real* __restrict px = x.data();
+    real* __restrict py = y.data();
+    const real* __restrict pvx = vx.data();
+    const real* __restrict pvy = vy.data();
+    const real step = static_cast<real>(duration);
 
-/*----------------------------------------
-|            update/modify               |
------------------------------------------*/
+    for ( unsigned i = start; i < end; ++i )
+    {
+        px[i] += pvx[i] * step;
+        py[i] += pvy[i] * step;
+    }
+}
 
-void Bodies::update(double dt)
+void Bodies::set_max_time_level(unsigned max_time_level)
 {
-    for ( unsigned i = 0; i < size; ++i )
+    this->max_time_level = std::min(max_time_level, MAX_TIME_LEVEL);
+    substep = 0;
+
+    for ( uint8_t& level : time_level )
     {
-        vel[i] += acc[i] * (0.5 * dt);
-        pos[i] += vel[i] * dt;
+        level = static_cast<uint8_t>(std::min<unsigned>(level, this->max_time_level));
     }
 }
 
@@ -82,60 +148,100 @@ void Bodies::resize(unsigned num_bodies)
         return;
 
     size = num_bodies;
+    resize_arrays(num_bodies);
+}
 
-    pos.resize(num_bodies);
-    vel.resize(num_bodies);
-    acc.resize(num_bodies, Vec2(0.0, 0.0));
+void Bodies::resize_arrays(unsigned num_bodies)
+{
+    // everything behind size stays zero, that is what keeps the padding massless
+    const unsigned padded = (num_bodies + PADDING - 1) / PADDING * PADDING;
 
-    mass.resize(num_bodies, 0.0);
-    radius.resize(num_bodies, 0.0);
+    for ( AlignedVector<real>* component : { &x, &y, &vx, &vy, &ax, &ay, &mass, &radius } )
+    {
+        component->resize(padded, 0.0);
+    }
 
-    to_be_deleted.resize(num_bodies, false);
+    to_be_deleted.resize(num_bodies, 0);
+    time_level.resize(num_bodies, 0);
 }
 
 void Bodies::clear()
 {
     size = 0;
 
-    pos.clear();
-    vel.clear();
-    acc.clear();
-
-    mass.clear();
-    radius.clear();
+    for ( AlignedVector<real>* component : { &x, &y, &vx, &vy, &ax, &ay, &mass, &radius } )
+    {
+        component->clear();
+    }
 
     to_be_deleted.clear();
+    time_level.clear();
 }
 
-void Bodies::remove_merged_bodies()
+const std::vector<uint32_t>& Bodies::remove_merged_bodies()
 {
-    for ( unsigned i = 0; i < size; ++i )
+    index_remap.resize(size);
+
+    // nothing moves in front of the first deleted body
+    const unsigned first = static_cast<unsigned>(std::find(to_be_deleted.begin(), to_be_deleted.begin() + size, 1) - to_be_deleted.begin());
+    for ( unsigned i = 0; i < first; ++i )
+    {
+        index_remap[i] = i;
+    }
+
+    if ( first == size )
+        return index_remap;
+
+    // every kept body moves down to the next free slot, the order stays the same
+    unsigned kept = first;
+    for ( unsigned i = first; i < size; ++i )
     {
         if ( to_be_deleted[i] )
         {
-            pos.erase(pos.begin() + i);
-            vel.erase(vel.begin() + i);
-            acc.erase(acc.begin() + i);
+            index_remap[i] = REMOVED;
+            continue;
+        }
 
-            mass.erase(mass.begin() + i);
-            radius.erase(radius.begin() + i);
+        x[kept] = x[i];
+        y[kept] = y[i];
+        vx[kept] = vx[i];
+        vy[kept] = vy[i];
+        ax[kept] = ax[i];
+        ay[kept] = ay[i];
+        mass[kept] = mass[i];
+        radius[kept] = radius[i];
+        time_level[kept] = time_level[i];
+
+        index_remap[i] = kept++;
+    }
 
-            to_be_deleted.erase(to_be_deleted.begin() + i);
-            --size;
-        }
+    // the freed tail becomes padding, which has to be zero again
+    for ( AlignedVector<real>* component : { &x, &y, &vx, &vy, &ax, &ay, &mass, &radius } )
+    {
+        std::fill(component->begin() + kept, component->begin() + size, real(0));
     }
+
+    std::fill(to_be_deleted.begin(), to_be_deleted.begin() + size, 0);
+
+    size = kept;
+    resize_arrays(size);
+
+    return index_remap;
 }
 
 void Bodies::merge_bodies(unsigned keep_index, unsigned remove_index)
 {
-    pos[keep_index] = (pos[keep_index] * mass[keep_index] + pos[remove_index] * mass[remove_index]) / (mass[keep_index] + mass[remove_index]);
-    vel[keep_index] = (vel[keep_index] * mass[keep_index] + vel[remove_index] * mass[remove_index]) / (mass[keep_index] + mass[remove_index]);
-    acc[keep_index] += acc[remove_index];
+    // center of mass, momentum and force are kept, the volume of the two spheres too
+    const real total_mass = mass[keep_index] + mass[remove_index];
+    pos[keep_index] = (pos[keep_index] * mass[keep_index] + pos[remove_index] * mass[remove_index]) / total_mass;
+    vel[keep_index] = (vel[keep_index] * mass[keep_index] + vel[remove_index] * mass[remove_index]) / total_mass;
+    acc[keep_index] = (acc[keep_index] * mass[keep_index] + acc[remove_index] * mass[remove_index]) / total_mass;
 
-    mass[keep_index] += mass[remove_index];
-    radius[keep_index] = std::pow(mass[keep_index], 1.0 / 3.0);
+    mass[keep_index] = total_mass;
+    radius[keep_index] = std::cbrt(radius[keep_index] * radius[keep_index] * radius[keep_index] + radius[remove_index] * radius[remove_index] * radius[remove_index]);
+    time_level[keep_index] = std::min(time_level[keep_index], time_level[remove_index]);
 
-    to_be_deleted[remove_index] = true;
+    to_be_deleted[remove_index] = 1;
 }
 
 
@@ -160,5 +266,5 @@ void Bodies::print(unsigned index) const
     std::cout << " - acc: " << acc[index] << std::endl;
     std::cout << " - mass: " << mass[index] << std::endl;
     std::cout << " - radius: " << radius[index] << std::endl;
-    std::cout << " - to_be_deleted: " << to_be_deleted[index] << std::endl;
+    std::cout << " - to_be_deleted: " << static_cast<unsigned>(to_be_deleted[index]) << std::endl;
 }
\ No newline at end of file
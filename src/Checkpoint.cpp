@@ -0,0 +1,198 @@
+#include "Checkpoint.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*----------------------------------------
+|               writing                  |
+-----------------------------------------*/
+
+CheckpointWriter::~CheckpointWriter()
+{
+    wait();
+}
+
+void CheckpointWriter::wait()
+{
+    if ( thread.joinable() )
+    {
+        thread.join();
+    }
+}
+
+bool CheckpointWriter::write(const std::string& path, const Bodies& bodies, const CheckpointState& state)
+{
+    if ( busy )
+    {
+        ++skipped;
+        return false;
+    }
+
+    // the thread of the last checkpoint is done, joining it does not wait
+    wait();
+
+    const uint64_t n = bodies.size;
+    const uint64_t array_stride = align(n * sizeof(real));
+
+    CheckpointHeader header {};
+    std::memcpy(header.magic, CheckpointHeader::MAGIC, sizeof(header.magic));
+    header.version = CheckpointHeader::VERSION;
+    header.real_size = sizeof(real);
+    header.num_bodies = n;
+    header.G = state.G;
+    header.theta = state.theta;
+    header.dt = state.dt;
+    header.steps = state.steps;
+    header.simulated_time = state.simulated_time;
+    header.integrator = bodies.integrator;
+    header.max_time_level = bodies.max_time_level;
+    header.time_step_accuracy = bodies.time_step_accuracy;
+    header.rng_state_offset = align(sizeof(CheckpointHeader));
+    header.rng_state_size = state.rng_state.size();
+    header.arrays_offset = align(header.rng_state_offset + header.rng_state_size);
+    header.file_size = header.arrays_offset + 8 * array_stride + n;
+
+    // the image is reused between checkpoints, everything is copied over except the alignment padding, which is zeroed
+    image.resize(header.file_size);
+    char* data = image.data();
+    std::memcpy(data, &header, sizeof(header));
+    std::memset(data + sizeof(header), 0, header.rng_state_offset - sizeof(header));
+    std::memcpy(data + header.rng_state_offset, state.rng_state.data(), header.rng_state_size);
+    std::memset(data + header.rng_state_offset + header.rng_state_size, 0, header.arrays_offset - header.rng_state_offset - header.rng_state_size);
+
+    char* array = data + header.arrays_offset;
+    for ( const AlignedVector<real>* component : { &bodies.x, &bodies.y, &bodies.vx, &bodies.vy, &bodies.ax, &bodies.ay, &bodies.mass, &bodies.radius } )
+    {
+        std::memcpy(array, component->data(), n * sizeof(real));
+        std::memset(array + n * sizeof(real), 0, array_stride - n * sizeof(real));
+        array += array_stride;
+    }
+    std::memcpy(array, bodies.time_level.data(), n);
+
+    busy = true;
+    thread = std::thread([this, path]()
+        {
+            const std::string temporary = path + ".tmp";
+
+            FILE* file = std::fopen(temporary.c_str(), "wb");
+            bool ok = file != nullptr;
+            if ( ok )
+            {
+                ok = std::fwrite(image.data(), 1, image.size(), file) == image.size();
+                ok = std::fclose(file) == 0 && ok;
+            }
+            ok = ok && std::rename(temporary.c_str(), path.c_str()) == 0;
+
+            if ( !ok )
+            {
+                std::remove(temporary.c_str());
+                std::cerr << "Error: could not write checkpoint " << path << std::endl;
+            }
+
+            last_succeeded = ok;
+            busy = false;
+        });
+
+    return true;
+}
+
+
+/*----------------------------------------
+|               reading                  |
+-----------------------------------------*/
+
+template <typename Stored>
+static void copy_array(const char* source, uint64_t n, real* destination)
+{
+    if constexpr ( std::is_same_v<Stored, real> )
+    {
+        std::memcpy(destination, source, n * sizeof(real));
+    }
+    else
+    {
+        const Stored* stored = reinterpret_cast<const Stored*>(source);
+        for ( uint64_t i = 0; i < n; ++i )
+        {
+            destination[i] = static_cast<real>(stored[i]);
+        }
+    }
+}
+
+bool read_checkpoint(const std::string& path, Bodies& bodies, CheckpointState& state)
+{
+    const int descriptor = open(path.c_str(), O_RDONLY);
+    if ( descriptor < 0 )
+        return false;
+
+    struct stat file_stat;
+    if ( fstat(descriptor, &file_stat) != 0 || static_cast<uint64_t>(file_stat.st_size) < sizeof(CheckpointHeader) )
+    {
+        close(descriptor);
+        return false;
+    }
+
+    // the pages are only read once, straight into the bodies
+    const uint64_t file_size = file_stat.st_size;
+    void* mapping = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    close(descriptor);
+
+    if ( mapping == MAP_FAILED )
+        return false;
+
+    madvise(mapping, file_size, MADV_SEQUENTIAL);
+
+    const char* data = static_cast<const char*>(mapping);
+    CheckpointHeader header;
+    std::memcpy(&header, data, sizeof(header));
+
+    const bool valid = std::memcmp(header.magic, CheckpointHeader::MAGIC, sizeof(header.magic)) == 0
+        && header.version == CheckpointHeader::VERSION
+        && (header.real_size == sizeof(float) || header.real_size == sizeof(double))
+        && header.file_size == file_size
+        && header.rng_state_offset + header.rng_state_size <= header.arrays_offset
+        && header.arrays_offset + 8 * CheckpointWriter::align(header.num_bodies * header.real_size) + header.num_bodies == file_size
+        && header.num_bodies <= UINT32_MAX;
+
+    if ( !valid )
+    {
+        munmap(mapping, file_size);
+        std::cerr << "Error: " << path << " is not a valid checkpoint" << std::endl;
+        return false;
+    }
+
+    const uint64_t n = header.num_bodies;
+    const uint64_t array_stride = CheckpointWriter::align(n * header.real_size);
+
+    bodies.clear();
+    bodies.resize(static_cast<unsigned>(n));
+
+    const char* array = data + header.arrays_offset;
+    for ( AlignedVector<real>* component : { &bodies.x, &bodies.y, &bodies.vx, &bodies.vy, &bodies.ax, &bodies.ay, &bodies.mass, &bodies.radius } )
+    {
+        if ( header.real_size == sizeof(float) )
+            copy_array<float>(array, n, component->data());
+        else
+            copy_array<double>(array, n, component->data());
+
+        array += array_stride;
+    }
+    std::memcpy(bodies.time_level.data(), array, n);
+
+    bodies.integrator = static_cast<enum Integrator>(header.integrator);
+    bodies.set_max_time_level(header.max_time_level);
+    bodies.time_step_accuracy = header.time_step_accuracy;
+
+    state.G = header.G;
+    state.theta = header.theta;
+    state.dt = header.dt;
+    state.steps = header.steps;
+    state.simulated_time = header.simulated_time;
+    state.rng_state.assign(data + header.rng_state_offset, header.rng_state_size);
+
+    munmap(mapping, file_size);
+    return true;
+}
@@ -0,0 +1,164 @@
+#include "Config.h"
+
+#include <algorithm>
+#include <fstream>
+
+static std::string trim(const std::string& text)
+{
+    const size_t first = text.find_first_not_of(" \t\r");
+    if ( first == std::string::npos )
+        return "";
+
+    const size_t last = text.find_last_not_of(" \t\r");
+    return text.substr(first, last - first + 1);
+}
+
+bool read_config(const std::string& config_file, Config& config)
+{
+    std::ifstream file(config_file);
+    if ( !file.is_open() )
+        return false;
+
+    std::string line;
+    while ( std::getline(file, line) )
+    {
+        line = trim(line.substr(0, line.find('#')));
+        if ( line.empty() )
+            continue;
+
+        size_t delimiterPos = line.find('=');
+        if ( delimiterPos != std::string::npos )
+        {
+            std::string key = trim(line.substr(0, delimiterPos));
+            std::string value = trim(line.substr(delimiterPos + 1));
+
+            if ( key == "G" )
+                config.G = std::stod(value);
+            else if ( key == "theta" )
+                config.theta = std::stod(value);
+            else if ( key == "dt" )
+                config.dt = std::stod(value);
+            else if ( key == "body_count" )
+                config.body_count = std::stoul(value);
+            else if ( key == "mass" )
+                config.mass = std::stod(value);
+            else if ( key == "height" )
+                config.height = std::stoi(value);
+            else if ( key == "width" )
+                config.width = std::stoi(value);
+            else if ( key == "threads" )
+                config.threads = std::stoul(value);
+            else if ( key == "pin_threads" )
+                config.pin_threads = std::stoi(value) != 0;
+            else if ( key == "leaf_capacity" )
+                config.leaf_capacity = std::stoul(value);
+            else if ( key == "fmm" )
+                config.fmm = std::stoi(value) != 0;
+            else if ( key == "multipole_order" )
+                config.multipole_order = std::stoul(value);
+            else if ( key == "refit" )
+                config.refit = std::stoi(value) != 0;
+            else if ( key == "verlet" )
+                config.verlet = std::stoi(value) != 0;
+            else if ( key == "time_levels" )
+                config.time_levels = std::stoul(value);
+            else if ( key == "collisions" )
+                config.collisions = std::stoi(value) != 0;
+            else if ( key == "time_rate" )
+                config.time_rate = std::stod(value);
+            else if ( key == "max_catch_up" )
+                config.max_catch_up = std::stoul(value);
+            else if ( key == "checkpoint" )
+                config.checkpoint = value;
+            else if ( key == "restart" )
+                config.restart = std::stoi(value) != 0;
+            else if ( key == "checkpoint_every" )
+                config.checkpoint_every = std::stoul(value);
+            else if ( key == "trajectory" )
+                config.trajectory = value;
+            else if ( key == "record" )
+                config.record = std::stoi(value) != 0;
+            else if ( key == "record_every" )
+                config.record_every = std::stoul(value);
+            else if ( key == "record_bandwidth" )
+                config.record_bandwidth = std::stod(value);
+            else if ( key == "position_bits" )
+                config.position_bits = std::stoul(value);
+            else if ( key == "velocity_bits" )
+                config.velocity_bits = std::stoul(value);
+            else if ( key == "keyframe_interval" )
+                config.keyframe_interval = std::stoul(value);
+            else if ( key == "export" )
+                config.export_frames = std::stoi(value) != 0;
+            else if ( key == "export_path" )
+                config.export_path = value;
+            else if ( key == "export_format" )
+                config.export_format = value == "raw" ? EXPORT_RAW : EXPORT_PNG;
+            else if ( key == "export_width" )
+                config.export_width = std::stoul(value);
+            else if ( key == "export_height" )
+                config.export_height = std::stoul(value);
+            else if ( key == "export_threads" )
+                config.export_threads = std::stoul(value);
+            else if ( key == "export_every" )
+                config.export_every = std::stoul(value);
+        }
+    }
+
+    return true;
+}
+
+std::shared_ptr<SimulationManager> create_simulation(const Config& config)
+{
+    std::shared_ptr<SimulationManager> simulation_manager = std::make_shared<SimulationManager>(config.width, config.height, "N-Body Simulation",
+        config.G, config.theta, config.dt, config.threads, config.pin_threads);
+
+    simulation_manager->set_leaf_capacity(config.leaf_capacity);
+    simulation_manager->set_multipole_order(config.multipole_order);
+    simulation_manager->set_refit(config.refit);
+    simulation_manager->set_integrator(config.verlet ? VELOCITY_VERLET : LEAPFROG_KDK);
+    simulation_manager->set_max_time_level(config.time_levels);
+    simulation_manager->set_collisions(config.collisions);
+    simulation_manager->set_time_rate(config.time_rate);
+    simulation_manager->set_max_catch_up_steps(config.max_catch_up);
+    simulation_manager->set_force_method(config.fmm ? FAST_MULTIPOLE : BARNES_HUT);
+    simulation_manager->set_checkpoint_path(config.checkpoint);
+    simulation_manager->set_checkpoint_interval(config.checkpoint_every);
+
+    simulation_manager->set_record_path(config.trajectory);
+    simulation_manager->set_record_interval(config.record_every);
+    TrajectoryRecorder& recorder = simulation_manager->get_recorder();
+    recorder.set_bits(config.position_bits, config.velocity_bits);
+    recorder.set_keyframe_interval(config.keyframe_interval);
+    recorder.set_bandwidth(config.record_bandwidth * 1e6);
+
+    if ( config.restart && simulation_manager->load_checkpoint(config.checkpoint) )
+    {
+        std::cout << "restarted from " << config.checkpoint << " at step " << simulation_manager->get_step() << std::endl;
+    }
+    else
+    {
+        simulation_manager->add_bodies(config.body_count, config.mass, BodyType::RANDOM);
+    }
+
+    if ( config.record )
+    {
+        simulation_manager->toggle_recording();
+    }
+
+    return simulation_manager;
+}
+
+std::shared_ptr<FrameExporter> create_exporter(const Config& config)
+{
+    std::shared_ptr<FrameExporter> exporter = std::make_shared<FrameExporter>(config.export_path, config.export_format,
+        std::max(1u, config.export_width), std::max(1u, config.export_height), config.export_threads);
+
+    if ( !exporter->is_open() )
+    {
+        std::cerr << "Error: could not create " << config.export_path << std::endl;
+        return nullptr;
+    }
+
+    return exporter;
+}
@@ -0,0 +1,412 @@
+#include "FastMultipole.h"
+
+/*----------------------------------------
+|         Constructor/Destructor         |
+-----------------------------------------*/
+
+FastMultipole::FastMultipole(std::shared_ptr<QuadTree> tree, std::shared_ptr<ThreadPool> thread_pool) :
+    tree(tree), thread_pool(thread_pool), thread_lists(thread_pool->get_num_threads()), thread_calculations(thread_pool->get_num_threads())
+{
+    // pascals triangle, the translations need n choose k up to n = 2 * order
+    const unsigned size = 2 * MAX_ORDER + 1;
+    binomial.assign(size * size, 0.0);
+
+    for ( unsigned n = 0; n < size; ++n )
+    {
+        binomial[n * size] = 1.0;
+        for ( unsigned k = 1; k <= n; ++k )
+        {
+            binomial[n * size + k] = binomial[(n - 1) * size + k - 1] + (k < n ? binomial[(n - 1) * size + k] : 0.0);
+        }
+    }
+
+    shifted_binomial.resize((MAX_ORDER + 1) * (MAX_ORDER + 1));
+    for ( unsigned k = 0; k <= MAX_ORDER; ++k )
+    {
+        for ( unsigned l = 0; l <= MAX_ORDER; ++l )
+        {
+            shifted_binomial[k * (MAX_ORDER + 1) + l] = choose(k + l, k);
+        }
+    }
+}
+
+
+/*----------------------------------------
+|             public methods             |
+-----------------------------------------*/
+
+void FastMultipole::update(double G, double dt, unsigned long& calculations_per_frame)
+{
+    const std::vector<QuadTree::Node>& nodes = tree->nodes;
+    const std::vector<QuadTree::BuildTask>& tasks = tree->build_tasks;
+    const unsigned n = tree->bodies->get_size();
+    const unsigned num_tasks = static_cast<unsigned>(tasks.size());
+    const std::size_t terms = order + 1;
+
+    multipoles.resize(nodes.size() * terms);
+    locals.resize(nodes.size() * terms);
+    radius.resize(nodes.size());
+    active_count.resize(nodes.size());
+    body_acc.resize(n);
+    body_active.resize(n);
+
+    // the build appends the subtrees behind the top levels
+    top_level_count = num_tasks > 0 ? tasks[0].offset : static_cast<uint32_t>(nodes.size());
+
+    task_of_node.assign(top_level_count, -1);
+    for ( unsigned task = 0; task < num_tasks; ++task )
+    {
+        task_of_node[tasks[task].node_index] = static_cast<int32_t>(task);
+    }
+
+    if ( pending.size() < num_tasks )
+    {
+        pending.resize(num_tasks);
+    }
+    for ( unsigned task = 0; task < num_tasks; ++task )
+    {
+        pending[task].clear();
+    }
+
+    std::fill(thread_calculations.begin(), thread_calculations.end(), 0);
+
+    // upward pass, subtrees in parallel, children always come after their parent
+    std::atomic<unsigned> next_task(0);
+    thread_pool->run([this, &nodes, &tasks, num_tasks, terms, &next_task](unsigned)
+        {
+            for ( unsigned task = next_task++; task < num_tasks; task = next_task++ )
+            {
+                const uint32_t first = tasks[task].offset;
+                const uint32_t last = first + static_cast<uint32_t>(tree->task_nodes[task].size());
+
+                // the task roots cover every body exactly once
+                const QuadTree::Node& root = nodes[tasks[task].node_index];
+                std::fill(body_acc.begin() + root.first_body, body_acc.begin() + root.first_body + root.body_count, Vec2T<double>(0.0, 0.0));
+                std::fill(locals.begin() + first * terms, locals.begin() + last * terms, Complex(0.0, 0.0));
+
+                for ( uint32_t i = last; i-- > first; )
+                {
+                    upward_pass(i);
+                }
+                upward_pass(tasks[task].node_index);
+            }
+        });
+
+    std::fill(locals.begin(), locals.begin() + top_level_count * terms, Complex(0.0, 0.0));
+    for ( uint32_t i = top_level_count; i-- > 0; )
+    {
+        if ( task_of_node[i] < 0 )
+        {
+            upward_pass(i);
+        }
+    }
+
+    // everything above the task roots is paired serially, the rest is handed to the tasks
+    interact(0, 0, true, thread_lists[0], thread_calculations[0]);
+
+    for ( uint32_t i = 0; i < top_level_count; ++i )
+    {
+        if ( task_of_node[i] < 0 )
+        {
+            downward_pass(i);
+        }
+    }
+
+    next_task = 0;
+    thread_pool->run([this, &tasks, num_tasks, &next_task](unsigned thread_index)
+        {
+            unsigned long local_calculations = 0;
+
+            for ( unsigned task = next_task++; task < num_tasks; task = next_task++ )
+            {
+                for ( const std::pair<uint32_t, uint32_t>& pair : pending[task] )
+                {
+                    interact(pair.first, pair.second, false, thread_lists[thread_index], local_calculations);
+                }
+
+                // the local expansion of the task root now holds everything, hand it down
+                const uint32_t first = tasks[task].offset;
+                const uint32_t last = first + static_cast<uint32_t>(tree->task_nodes[task].size());
+
+                downward_pass(tasks[task].node_index);
+                for ( uint32_t i = first; i < last; ++i )
+                {
+                    downward_pass(i);
+                }
+            }
+
+            thread_calculations[thread_index] += local_calculations;
+        });
+
+    // back into the original body order, together with the closing kick of the step, for the active bodies
+    const real half_step = static_cast<real>(0.5 * dt);
+    thread_pool->parallel_for(0, n, [this, G, half_step](unsigned start, unsigned end, unsigned)
+        {
+            for ( unsigned k = start; k < end; ++k )
+            {
+                if ( !tree->bodies->is_active(tree->order[k]) )
+                {
+                    continue;
+                }
+
+                tree->bodies->finish_step(tree->order[k], static_cast<real>(body_acc[k].x * G), static_cast<real>(body_acc[k].y * G), half_step);
+            }
+        }, 16384);
+
+    calculations_per_frame = 0;
+    for ( unsigned long calculations : thread_calculations )
+    {
+        calculations_per_frame += calculations;
+    }
+}
+
+
+/*----------------------------------------
+|             private methods            |
+-----------------------------------------*/
+
+void FastMultipole::upward_pass(uint32_t node_index)
+{
+    const QuadTree::Node& node = tree->nodes[node_index];
+    const Complex c = center(node_index);
+    Complex* multipole = &multipoles[node_index * (order + 1)];
+
+    std::fill(multipole, multipole + order + 1, Complex(0.0, 0.0));
+    radius[node_index] = 0.0;
+    active_count[node_index] = 0;
+
+    if ( node.is_leaf() )
+    {
+        // a_k = sum m (w - c)^k
+        for ( uint32_t k = node.first_body; k < node.first_body + node.body_count; ++k )
+        {
+            body_active[k] = tree->bodies->is_active(tree->order[k]);
+            active_count[node_index] += body_active[k];
+
+            const Complex d = Complex(tree->body_pos[k].x, tree->body_pos[k].y) - c;
+            radius[node_index] = std::max(radius[node_index], std::abs(d));
+
+            Complex power = tree->body_mass[k];
+            for ( unsigned term = 0; term <= order; ++term )
+            {
+                multipole[term] += power;
+                power = multiply(power, d);
+            }
+        }
+        return;
+    }
+
+    for ( uint32_t child = node.first_child; child < node.first_child + 4; ++child )
+    {
+        if ( tree->nodes[child].body_count == 0 )
+        {
+            continue;
+        }
+
+        active_count[node_index] += active_count[child];
+
+        // shift the child expansion to our center: a'_k = sum_j (k choose j) a_j d^(k - j)
+        const Complex d = center(child) - c;
+        const Complex* child_multipole = &multipoles[child * (order + 1)];
+        radius[node_index] = std::max(radius[node_index], std::abs(d) + radius[child]);
+
+        Complex d_power[MAX_ORDER + 1];
+        d_power[0] = 1.0;
+        for ( unsigned term = 1; term <= order; ++term )
+        {
+            d_power[term] = multiply(d_power[term - 1], d);
+        }
+
+        for ( unsigned k = 0; k <= order; ++k )
+        {
+            Complex sum = 0.0;
+            for ( unsigned j = 0; j <= k; ++j )
+            {
+                sum += choose(k, j) * multiply(child_multipole[j], d_power[k - j]);
+            }
+            multipole[k] += sum;
+        }
+    }
+}
+
+void FastMultipole::downward_pass(uint32_t node_index)
+{
+    const QuadTree::Node& node = tree->nodes[node_index];
+    if ( active_count[node_index] == 0 )
+    {
+        return;
+    }
+
+    const Complex c = center(node_index);
+    const Complex* local = &locals[node_index * (order + 1)];
+
+    if ( node.is_leaf() )
+    {
+        // g(z) = sum b_l (z - c)^l with horner, a = -conj(g)
+        for ( uint32_t k = node.first_body; k < node.first_body + node.body_count; ++k )
+        {
+            if ( !body_active[k] )
+                continue;
+
+            const Complex z = Complex(tree->body_pos[k].x, tree->body_pos[k].y) - c;
+
+            Complex g = local[order];
+            for ( unsigned term = order; term-- > 0; )
+            {
+                g = multiply(g, z) + local[term];
+            }
+
+            body_acc[k] += Vec2T<double>(-g.real(), g.imag());
+        }
+        return;
+    }
+
+    for ( uint32_t child = node.first_child; child < node.first_child + 4; ++child )
+    {
+        if ( active_count[child] == 0 )
+        {
+            continue;
+        }
+
+        // b'_m = sum_{l >= m} (l choose m) b_l d^(l - m)
+        const Complex d = center(child) - c;
+        Complex* child_local = &locals[child * (order + 1)];
+
+        Complex d_power[MAX_ORDER + 1];
+        d_power[0] = 1.0;
+        for ( unsigned term = 1; term <= order; ++term )
+        {
+            d_power[term] = multiply(d_power[term - 1], d);
+        }
+
+        for ( unsigned m = 0; m <= order; ++m )
+        {
+            Complex sum = 0.0;
+            for ( unsigned l = m; l <= order; ++l )
+            {
+                sum += choose(l, m) * multiply(local[l], d_power[l - m]);
+            }
+            child_local[m] += sum;
+        }
+    }
+}
+
+void FastMultipole::interact(uint32_t target, uint32_t source, bool defer, InteractionList& list, unsigned long& calculations)
+{
+    const QuadTree::Node& a = tree->nodes[target];
+    const QuadTree::Node& b = tree->nodes[source];
+
+    // a cell without active bodies needs no field
+    if ( active_count[target] == 0 || b.body_count == 0 )
+    {
+        return;
+    }
+
+    if ( defer && target < top_level_count && task_of_node[target] >= 0 )
+    {
+        pending[task_of_node[target]].push_back({ target, source });
+        return;
+    }
+
+    if ( target != source && radius[target] + radius[source] < opening_angle * std::abs(center(target) - center(source)) )
+    {
+        multipole_to_local(target, source);
+        ++calculations;
+        return;
+    }
+
+    if ( a.is_leaf() && b.is_leaf() )
+    {
+        particle_to_particle(target, source, list);
+        calculations += static_cast<unsigned long>(active_count[target]) * b.body_count;
+        return;
+    }
+
+    if ( target == source )
+    {
+        for ( uint32_t i = a.first_child; i < a.first_child + 4; ++i )
+        {
+            for ( uint32_t j = a.first_child; j < a.first_child + 4; ++j )
+            {
+                interact(i, j, defer, list, calculations);
+            }
+        }
+    }
+    else if ( b.is_leaf() || (!a.is_leaf() && radius[target] >= radius[source]) )
+    {
+        for ( uint32_t i = a.first_child; i < a.first_child + 4; ++i )
+        {
+            interact(i, source, defer, list, calculations);
+        }
+    }
+    else
+    {
+        for ( uint32_t j = b.first_child; j < b.first_child + 4; ++j )
+        {
+            interact(target, j, defer, list, calculations);
+        }
+    }
+}
+
+void FastMultipole::multipole_to_local(uint32_t target, uint32_t source)
+{
+    // b_l += (-1)^l / t^(l + 1) * sum_k (k + l choose k) a_k / t^k,  t = c_target - c_source
+    const Complex t = center(target) - center(source);
+    const Complex inverse = std::conj(t) / std::norm(t);
+    const Complex* multipole = &multipoles[source * (order + 1)];
+    Complex* local = &locals[target * (order + 1)];
+
+    // scaling first leaves only real * complex products in the double loop
+    Complex scaled[MAX_ORDER + 1];
+    Complex power = 1.0;
+    for ( unsigned k = 0; k <= order; ++k )
+    {
+        scaled[k] = multiply(multipole[k], power);
+        power = multiply(power, inverse);
+    }
+
+    // k outside so the sums over l are independent, otherwise every term waits for the previous add
+    double sum_real[MAX_ORDER + 1] = {};
+    double sum_imag[MAX_ORDER + 1] = {};
+    for ( unsigned k = 0; k <= order; ++k )
+    {
+        const double* row = &shifted_binomial[k * (MAX_ORDER + 1)];
+        for ( unsigned l = 0; l <= order; ++l )
+        {
+            sum_real[l] += row[l] * scaled[k].real();
+            sum_imag[l] += row[l] * scaled[k].imag();
+        }
+    }
+
+    power = inverse;
+    for ( unsigned l = 0; l <= order; ++l )
+    {
+        local[l] += multiply(Complex(sum_real[l], sum_imag[l]), l & 1 ? -power : power);
+        power = multiply(power, inverse);
+    }
+}
+
+void FastMultipole::particle_to_particle(uint32_t target, uint32_t source, InteractionList& list)
+{
+    const QuadTree::Node& a = tree->nodes[target];
+    const QuadTree::Node& b = tree->nodes[source];
+
+    // the source bodies go through the same vector kernel as the tree walk, a body adds exactly 0 to itself
+    list.clear();
+    list.reserve_more(b.body_count);
+    for ( uint32_t j = b.first_body; j < b.first_body + b.body_count; ++j )
+    {
+        list.push_unchecked(tree->body_pos[j].x, tree->body_pos[j].y, tree->body_mass[j], true);
+    }
+    list.pad();
+
+    for ( uint32_t i = a.first_body; i < a.first_body + a.body_count; ++i )
+    {
+        if ( !body_active[i] )
+            continue;
+
+        accumulator acc_x, acc_y;
+        evaluate_interactions(list, tree->body_pos[i].x, tree->body_pos[i].y, acc_x, acc_y);
+        body_acc[i] += Vec2T<double>(acc_x, acc_y);
+    }
+}
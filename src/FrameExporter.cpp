@@ -0,0 +1,435 @@
+#include "FrameExporter.h"
+
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+/*----------------------------------------
+|              png encoder               |
+-----------------------------------------*/
+
+/*
+deflate with the fixed huffman codes and greedy lz77 matches, no dynamic tables. rendered frames are mostly
+black with a few bright points, the runs of black (matches at distance 1 and 4) carry almost all of the compression,
+so this ends up about as small and as fast as the fastest level of zlib, without depending on it.
+*/
+namespace {
+
+constexpr unsigned MIN_MATCH = 4;       // deflate allows 3, 4 bytes hash better and lose little
+constexpr unsigned MAX_MATCH = 258;
+constexpr unsigned WINDOW = 32768;
+constexpr unsigned HASH_BITS = 15;
+
+struct FixedCodes {
+    uint16_t literal_code[288];     // bit reversed, deflate writes huffman codes from the most significant bit
+    uint8_t literal_length[288];
+    uint8_t distance_code[30];
+
+    FixedCodes()
+    {
+        auto reverse = [](unsigned code, unsigned length)
+            {
+                unsigned reversed = 0;
+                for ( unsigned i = 0; i < length; ++i )
+                {
+                    reversed = (reversed << 1) | ((code >> i) & 1);
+                }
+                return reversed;
+            };
+
+        for ( unsigned symbol = 0; symbol < 288; ++symbol )
+        {
+            unsigned code, length;
+            if ( symbol < 144 )         { code = 0x30 + symbol;          length = 8; }
+            else if ( symbol < 256 )    { code = 0x190 + symbol - 144;   length = 9; }
+            else if ( symbol < 280 )    { code = symbol - 256;           length = 7; }
+            else                        { code = 0xc0 + symbol - 280;    length = 8; }
+
+            literal_code[symbol] = static_cast<uint16_t>(reverse(code, length));
+            literal_length[symbol] = static_cast<uint8_t>(length);
+        }
+
+        for ( unsigned symbol = 0; symbol < 30; ++symbol )
+        {
+            distance_code[symbol] = static_cast<uint8_t>(reverse(symbol, 5));
+        }
+    }
+};
+
+const FixedCodes fixed_codes;
+
+// least significant bit first, as deflate wants it
+struct BitWriter {
+    uint8_t* out;
+    uint64_t bits = 0;
+    unsigned count = 0;
+
+    inline void put(uint32_t value, unsigned length)
+    {
+        bits |= static_cast<uint64_t>(value) << count;
+        count += length;
+        if ( count >= 32 )
+        {
+            const uint32_t word = static_cast<uint32_t>(bits);
+            std::memcpy(out, &word, sizeof(word));
+            out += sizeof(word);
+            bits >>= 32;
+            count -= 32;
+        }
+    }
+
+    inline void finish()
+    {
+        while ( count > 0 )
+        {
+            *out++ = static_cast<uint8_t>(bits);
+            bits >>= 8;
+            count = count > 8 ? count - 8 : 0;
+        }
+    }
+};
+
+inline void put_literal(BitWriter& writer, unsigned symbol)
+{
+    writer.put(fixed_codes.literal_code[symbol], fixed_codes.literal_length[symbol]);
+}
+
+inline void put_match(BitWriter& writer, unsigned length, unsigned distance)
+{
+    // length symbols 257 - 264 are 3 - 10, from there on every 4 symbols double the range, 285 is 258
+    if ( length <= 10 )
+    {
+        put_literal(writer, 257 + length - 3);
+    }
+    else if ( length == MAX_MATCH )
+    {
+        put_literal(writer, 285);
+    }
+    else
+    {
+        const unsigned l = length - 3;
+        const unsigned bits = 31 - __builtin_clz(l);
+        put_literal(writer, 257 + 4 * (bits - 1) + ((l >> (bits - 2)) & 3));
+        writer.put(l & ((1u << (bits - 2)) - 1), bits - 2);
+    }
+
+    // distance symbols 0 - 3 are 1 - 4, from there on every 2 symbols double the range
+    const unsigned d = distance - 1;
+    if ( d < 4 )
+    {
+        writer.put(fixed_codes.distance_code[d], 5);
+    }
+    else
+    {
+        const unsigned bits = 31 - __builtin_clz(d);
+        writer.put(fixed_codes.distance_code[2 * bits + ((d >> (bits - 1)) & 1)], 5);
+        writer.put(d & ((1u << (bits - 1)) - 1), bits - 1);
+    }
+}
+
+inline uint32_t read32(const uint8_t* p)
+{
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// zlib stream (header, one fixed huffman block, adler32) of the data
+void deflate(const uint8_t* data, std::size_t size, std::vector<uint8_t>& out, std::vector<uint32_t>& hash_table)
+{
+    // at worst every byte is a 9 bit literal
+    out.resize(size + size / 8 + 64);
+    hash_table.assign(1u << HASH_BITS, 0);
+
+    out[0] = 0x78;      // deflate, 32k window
+    out[1] = 0x01;      // no dictionary, fastest, (0x7801 % 31 == 0)
+
+    BitWriter writer { out.data() + 2 };
+    writer.put(1, 1);   // final block
+    writer.put(1, 2);   // fixed huffman codes
+
+    std::size_t i = 0;
+    const std::size_t match_limit = size > MIN_MATCH ? size - MIN_MATCH : 0;
+    while ( i < match_limit )
+    {
+        const uint32_t sequence = read32(data + i);
+        const uint32_t hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+        const std::size_t candidate = hash_table[hash];     // position + 1, 0 is empty
+        hash_table[hash] = static_cast<uint32_t>(i + 1);
+
+        if ( candidate != 0 && i + 1 - candidate <= WINDOW && read32(data + candidate - 1) == sequence )
+        {
+            const std::size_t match = candidate - 1;
+            const std::size_t longest = std::min<std::size_t>(MAX_MATCH, size - i);
+
+            std::size_t length = MIN_MATCH;
+            while ( length < longest && data[match + length] == data[i + length] )
+            {
+                ++length;
+            }
+
+            put_match(writer, static_cast<unsigned>(length), static_cast<unsigned>(i - match));
+            i += length;
+        }
+        else
+        {
+            put_literal(writer, data[i]);
+            ++i;
+        }
+    }
+    for ( ; i < size; ++i )
+    {
+        put_literal(writer, data[i]);
+    }
+
+    put_literal(writer, 256);   // end of block
+    writer.finish();
+
+    // adler32, the sums are reduced every 5552 bytes before they can overflow
+    uint32_t a = 1, b = 0;
+    for ( std::size_t start = 0; start < size; start += 5552 )
+    {
+        const std::size_t end = std::min<std::size_t>(size, start + 5552);
+        for ( std::size_t k = start; k < end; ++k )
+        {
+            a += data[k];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    const uint32_t adler = (b << 16) | a;
+
+    uint8_t* tail = writer.out;
+    *tail++ = static_cast<uint8_t>(adler >> 24);
+    *tail++ = static_cast<uint8_t>(adler >> 16);
+    *tail++ = static_cast<uint8_t>(adler >> 8);
+    *tail++ = static_cast<uint8_t>(adler);
+
+    out.resize(tail - out.data());
+}
+
+uint32_t crc32(const uint8_t* data, std::size_t size, uint32_t crc = 0)
+{
+    static const struct CrcTable {
+        uint32_t entries[256];
+        CrcTable()
+        {
+            for ( uint32_t n = 0; n < 256; ++n )
+            {
+                uint32_t c = n;
+                for ( unsigned k = 0; k < 8; ++k )
+                {
+                    c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                }
+                entries[n] = c;
+            }
+        }
+    } table;
+
+    crc = ~crc;
+    for ( std::size_t i = 0; i < size; ++i )
+    {
+        crc = table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+bool write_chunk(FILE* file, const char type[4], const uint8_t* data, std::size_t size)
+{
+    const uint8_t length[4] = { static_cast<uint8_t>(size >> 24), static_cast<uint8_t>(size >> 16), static_cast<uint8_t>(size >> 8), static_cast<uint8_t>(size) };
+    const uint32_t crc = crc32(data, size, crc32(reinterpret_cast<const uint8_t*>(type), 4));
+    const uint8_t crc_bytes[4] = { static_cast<uint8_t>(crc >> 24), static_cast<uint8_t>(crc >> 16), static_cast<uint8_t>(crc >> 8), static_cast<uint8_t>(crc) };
+
+    return std::fwrite(length, 1, 4, file) == 4
+        && std::fwrite(type, 1, 4, file) == 4
+        && std::fwrite(data, 1, size, file) == size
+        && std::fwrite(crc_bytes, 1, 4, file) == 4;
+}
+
+} // namespace
+
+bool write_png(const std::string& path, unsigned width, unsigned height, const uint8_t* rgba)
+{
+    // every thread of the exporter keeps its buffers, a frame at 4k is more than 30 MB
+    thread_local std::vector<uint8_t> scanlines;
+    thread_local std::vector<uint8_t> compressed;
+    thread_local std::vector<uint32_t> hash_table;
+
+    // filter type 0 (none) in front of every row, the black runs compress better unfiltered
+    const std::size_t row = 4 * static_cast<std::size_t>(width);
+    scanlines.resize((row + 1) * height);
+    for ( unsigned y = 0; y < height; ++y )
+    {
+        scanlines[y * (row + 1)] = 0;
+        std::memcpy(&scanlines[y * (row + 1) + 1], rgba + y * row, row);
+    }
+
+    deflate(scanlines.data(), scanlines.size(), compressed, hash_table);
+
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if ( file == nullptr )
+        return false;
+
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    const uint8_t header[13] = {
+        static_cast<uint8_t>(width >> 24), static_cast<uint8_t>(width >> 16), static_cast<uint8_t>(width >> 8), static_cast<uint8_t>(width),
+        static_cast<uint8_t>(height >> 24), static_cast<uint8_t>(height >> 16), static_cast<uint8_t>(height >> 8), static_cast<uint8_t>(height),
+        8,      // bits per channel
+        6,      // rgba
+        0, 0, 0 // deflate, adaptive filtering, no interlace
+    };
+
+    bool ok = std::fwrite(signature, 1, sizeof(signature), file) == sizeof(signature)
+        && write_chunk(file, "IHDR", header, sizeof(header))
+        && write_chunk(file, "IDAT", compressed.data(), compressed.size())
+        && write_chunk(file, "IEND", nullptr, 0);
+
+    ok = std::fclose(file) == 0 && ok;
+    return ok;
+}
+
+
+/*----------------------------------------
+|               exporter                 |
+-----------------------------------------*/
+
+FrameExporter::FrameExporter(const std::string& path, ExportFormat format, unsigned width, unsigned height, unsigned threads)
+    : path(path), format(format), width(width), height(height)
+{
+    if ( format == EXPORT_RAW )
+    {
+        raw_file = std::fopen(path.c_str(), "wb");
+        if ( raw_file == nullptr )
+        {
+            std::cerr << "Error: could not create " << path << std::endl;
+        }
+        threads = 1;
+    }
+    else if ( threads == 0 )
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // two spare buffers, the producer can render the next frame while every thread is busy
+    for ( unsigned i = 0; i < threads + 2; ++i )
+    {
+        frames.push_back(std::make_unique<Frame>());
+        free_frames.push_back(frames.back().get());
+    }
+
+    for ( unsigned i = 0; i < threads; ++i )
+    {
+        workers.emplace_back(&FrameExporter::work, this);
+    }
+}
+
+FrameExporter::~FrameExporter()
+{
+    flush();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    frame_queued.notify_all();
+
+    for ( std::thread& worker : workers )
+    {
+        worker.join();
+    }
+
+    if ( raw_file != nullptr )
+    {
+        std::fclose(raw_file);
+    }
+}
+
+uint8_t* FrameExporter::acquire()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        frame_done.wait(lock, [this]() { return !free_frames.empty(); });
+
+        current = free_frames.back();
+        free_frames.pop_back();
+    }
+
+    // the buffers are only allocated once they are first used
+    current->pixels.resize(4 * static_cast<std::size_t>(width) * height);
+    return current->pixels.data();
+}
+
+void FrameExporter::submit()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current->index = next_index++;
+        queued_frames.push_back(current);
+        ++in_flight;
+        current = nullptr;
+    }
+    frame_queued.notify_one();
+}
+
+void FrameExporter::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    frame_done.wait(lock, [this]() { return in_flight == 0; });
+}
+
+void FrameExporter::work()
+{
+    while ( true )
+    {
+        Frame* frame;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            frame_queued.wait(lock, [this]() { return stopping || !queued_frames.empty(); });
+            if ( queued_frames.empty() )
+                return;
+
+            frame = queued_frames.front();
+            queued_frames.pop_front();
+        }
+
+        export_frame(*frame);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            free_frames.push_back(frame);
+            --in_flight;
+        }
+        frame_done.notify_all();
+    }
+}
+
+void FrameExporter::export_frame(const Frame& frame)
+{
+    const std::chrono::high_resolution_clock::time_point start_time = std::chrono::high_resolution_clock::now();
+
+    bool ok;
+    if ( format == EXPORT_RAW )
+    {
+        ok = raw_file != nullptr && std::fwrite(frame.pixels.data(), 1, frame.pixels.size(), raw_file) == frame.pixels.size();
+    }
+    else
+    {
+        std::ostringstream name;
+        name << path << "_" << std::setw(6) << std::setfill('0') << frame.index << ".png";
+        ok = write_png(name.str(), width, height, frame.pixels.data());
+    }
+
+    if ( ok )
+    {
+        ++exported_frames;
+    }
+    else if ( failed_frames++ == 0 )
+    {
+        std::cerr << "Error: could not export frame " << frame.index << " to " << path << std::endl;
+    }
+
+    encode_time.fetch_add(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count());
+}
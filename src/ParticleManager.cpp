@@ -4,8 +4,8 @@
 |         Constructor/Destructor         |
 -----------------------------------------*/
 
-ParticleManager::ParticleManager(std::shared_ptr<Bodies> bodies, unsigned width, unsigned height) :
-    bodies(bodies), width(width), height(height)
+ParticleManager::ParticleManager(std::shared_ptr<Bodies> bodies, unsigned width, unsigned height, std::shared_ptr<ThreadPool> thread_pool) :
+    bodies(bodies), thread_pool(thread_pool), body_type(BodyType::RANDOM), mass(1.0), width(width), height(height), gen(std::random_device()())
 {}
 
 ParticleManager::~ParticleManager()
@@ -57,27 +57,49 @@ void ParticleManager::get_particle_area(Vec2& top_left, Vec2& bottom_right)
     top_left = Vec2(width, height);
     bottom_right = Vec2(0, 0);
 
-    // Find the bounding square that contains all particles
-    for ( unsigned i = 0; i < bodies->get_size(); ++i )
+    // min / max on local copies without branches, so the loop vectorizes over the x and y arrays
+    auto find_bounds = [this](unsigned start, unsigned end, Vec2& top_left, Vec2& bottom_right)
     {
-        if ( bodies->pos[i].x < top_left.x )
-        {
-            top_left.x = bodies->pos[i].x;
-        }
+        const real* __restrict x = bodies->x.data();
+        const real* __restrict y = bodies->y.data();
 
-        if ( bodies->pos[i].x > bottom_right.x )
-        {
-            bottom_right.x = bodies->pos[i].x;
-        }
+        real min_x = top_left.x, min_y = top_left.y;
+        real max_x = bottom_right.x, max_y = bottom_right.y;
 
-        if ( bodies->pos[i].y < top_left.y )
+        for ( unsigned i = start; i < end; ++i )
         {
-            top_left.y = bodies->pos[i].y;
+            min_x = x[i] < min_x ? x[i] : min_x;
+            max_x = x[i] > max_x ? x[i] : max_x;
+            min_y = y[i] < min_y ? y[i] : min_y;
+            max_y = y[i] > max_y ? y[i] : max_y;
         }
 
-        if ( bodies->pos[i].y > bottom_right.y )
+        top_left = Vec2(min_x, min_y);
+        bottom_right = Vec2(max_x, max_y);
+    };
+
+    // Find the bounding square that contains all particles
+    if ( thread_pool == nullptr )
+    {
+        find_bounds(0, bodies->get_size(), top_left, bottom_right);
+    }
+    else
+    {
+        // every thread reduces its own chunk, the partial boxes are merged afterwards
+        thread_top_left.assign(thread_pool->get_num_threads(), top_left);
+        thread_bottom_right.assign(thread_pool->get_num_threads(), bottom_right);
+
+        thread_pool->parallel_for(0, bodies->get_size(), [this, &find_bounds](unsigned start, unsigned end, unsigned thread_index)
+            {
+                find_bounds(start, end, thread_top_left[thread_index], thread_bottom_right[thread_index]);
+            }, 16384);
+
+        for ( unsigned t = 0; t < thread_pool->get_num_threads(); ++t )
         {
-            bottom_right.y = bodies->pos[i].y;
+            top_left.x = std::min(top_left.x, thread_top_left[t].x);
+            top_left.y = std::min(top_left.y, thread_top_left[t].y);
+            bottom_right.x = std::max(bottom_right.x, thread_bottom_right[t].x);
+            bottom_right.y = std::max(bottom_right.y, thread_bottom_right[t].y);
         }
     }
 
@@ -99,6 +121,26 @@ void ParticleManager::get_particle_area(Vec2& top_left, Vec2& bottom_right)
     }
 }
 
+std::string ParticleManager::get_rng_state() const
+{
+    std::ostringstream state;
+    state << gen;
+    return state.str();
+}
+
+bool ParticleManager::set_rng_state(const std::string& rng_state)
+{
+    std::istringstream state(rng_state);
+    std::mt19937 restored;
+    state >> restored;
+
+    if ( state.fail() )
+        return false;
+
+    gen = restored;
+    return true;
+}
+
 void ParticleManager::reset()
 {
     unsigned size = this->bodies->get_size();
@@ -148,8 +190,8 @@ void ParticleManager::add_galaxy(unsigned count, double mass)
         bodies->mass[i] = mass;
         bodies->radius[i] = std::pow(bodies->mass[i], 1.0 / 3.0);
 
-        double angle = static_cast<double>(rand()) / RAND_MAX * 2.0 * M_PI; // Random angle in radians
-        double distance = static_cast<double>(rand()) / RAND_MAX * max_distance; // Random distance from the center
+        double angle = random_unit() * 2.0 * M_PI; // Random angle in radians
+        double distance = random_unit() * max_distance; // Random distance from the center
 
         double totalArmAngle = 5.0;
 
@@ -191,8 +233,8 @@ void ParticleManager::add_rotating_cubes(unsigned count, double mass)
         bodies->mass[i] = mass;
         bodies->radius[i] = 1.0;
 
-        double x = center_top_left_x + (static_cast<double>(rand()) / RAND_MAX - 0.5) * cubeSize;
-        double y = center_top_left_y + (static_cast<double>(rand()) / RAND_MAX - 0.5) * cubeSize;
+        double x = center_top_left_x + (random_unit() - 0.5) * cubeSize;
+        double y = center_top_left_y + (random_unit() - 0.5) * cubeSize;
         bodies->pos[i] = Vec2(x, y);
 
         Vec2 direction = (bodies->pos[i] - Vec2(center_top_left_x, center_top_left_y)).normalize();
@@ -206,8 +248,8 @@ void ParticleManager::add_rotating_cubes(unsigned count, double mass)
         bodies->mass[i] = mass;
         bodies->radius[i] = cubeSize;
 
-        double x = center_bottom_right_x + (static_cast<double>(rand()) / RAND_MAX - 0.5) * cubeSize;
-        double y = center_bottom_right_y + (static_cast<double>(rand()) / RAND_MAX - 0.5) * cubeSize;
+        double x = center_bottom_right_x + (random_unit() - 0.5) * cubeSize;
+        double y = center_bottom_right_y + (random_unit() - 0.5) * cubeSize;
         bodies->pos[i] = Vec2(x, y);
 
         Vec2 direction = (bodies->pos[i] - Vec2(center_bottom_right_x, center_bottom_right_y)).normalize();
@@ -227,8 +269,6 @@ void ParticleManager::add_rotating_cubes(unsigned count, double mass)
 
 void ParticleManager::add_random(unsigned count, double mass)
 {
-    std::random_device rd;
-    std::mt19937 gen(rd());
     std::normal_distribution<double> distribution(0.0, 1.0);
 
     double edgeOffsetX = width / 10.0;
@@ -269,8 +309,8 @@ void ParticleManager::add_large_cube(unsigned count, double mass)
         bodies->mass[i] = mass;
         bodies->radius[i] = 1.0;
 
-        double x = center_x + (static_cast<double>(rand()) / RAND_MAX - 0.5) * cubeSize;
-        double y = center_y + (static_cast<double>(rand()) / RAND_MAX - 0.5) * cubeSize;
+        double x = center_x + (random_unit() - 0.5) * cubeSize;
+        double y = center_y + (random_unit() - 0.5) * cubeSize;
         bodies->pos[i] = Vec2(x, y);
 
         Vec2 direction = (bodies->pos[i] - Vec2(center_x, center_y)).normalize();
@@ -4,87 +4,352 @@
 |         Constructor/Destructor         |
 -----------------------------------------*/
 
-QuadTree::QuadTree(std::shared_ptr<Bodies> bodies, Vec2 top_left, Vec2 bottom_right, std::shared_ptr<sf::VertexArray> rectangles, bool root) :
-    top_left(top_left), bottom_right(bottom_right), rectangles(rectangles)
+QuadTree::QuadTree(std::shared_ptr<Bodies> bodies, std::shared_ptr<ThreadPool> thread_pool) :
+    thread_pool(thread_pool), thread_calculations(thread_pool->get_num_threads()), thread_lists(thread_pool->get_num_threads()),
+    thread_cell_lists(thread_pool->get_num_threads()),
+    thread_busy_time(thread_pool->get_num_threads(), 0.0), thread_idle_time(thread_pool->get_num_threads(), 0.0),
+    thread_overlap(thread_pool->get_num_threads(), 0.0), thread_area(thread_pool->get_num_threads(), 0.0),
+    thread_max_radius(thread_pool->get_num_threads(), 0), thread_candidates(thread_pool->get_num_threads()),
+    thread_collisions(thread_pool->get_num_threads())
 {
     this->bodies = bodies;
 
-    center_of_mass = Vec2(0, 0);
-    mass = 0.0;
+    nodes.emplace_back();
+}
+
+QuadTree::QuadTree(std::shared_ptr<Bodies> bodies, std::shared_ptr<ThreadPool> thread_pool, Vec2 top_left, Vec2 bottom_right) :
+    QuadTree(bodies, thread_pool)
+{
+    build(top_left, bottom_right);
+}
+
+QuadTree::QuadTree(std::shared_ptr<Bodies> bodies, std::shared_ptr<ThreadPool> thread_pool, double xmin, double ymin, double xmax, double ymax) :
+    QuadTree(bodies, thread_pool, Vec2(xmin, ymin), Vec2(xmax, ymax))
+{}
+
+QuadTree::~QuadTree()
+{
+    nodes.clear();
+}
+
+
+/*----------------------------------------
+|             public methods             |
+-----------------------------------------*/
+
+void QuadTree::build(Vec2 top_left, Vec2 bottom_right)
+{
+    const auto build_start = std::chrono::high_resolution_clock::now();
+    const unsigned n = bodies->get_size();
+
+    // the root has to be square, otherwise the cells would not line up with the morton grid
+    const double size = std::max(bottom_right.x - top_left.x, bottom_right.y - top_left.y);
+    const Vec2 center = (top_left + bottom_right) / 2.0;
+
+    keys.resize(n);
+    keys_tmp.resize(n);
+    order.resize(n);
+    order_tmp.resize(n);
+    body_pos.resize(n);
+    body_mass.resize(n);
+
+    compute_keys(center - Vec2(size / 2.0, size / 2.0), size);
+    sort_keys();
+
+    const unsigned threads = n < PARALLEL_THRESHOLD ? 1 : thread_pool->get_num_threads();
+    copy_sorted_bodies(threads);
+
+    // the moment pass below reads this
+    built_with_quadrupoles = quadrupole;
+
+    // clear() keeps the capacity, after the first few frames the tree never allocates again
+    nodes.clear();
+    build_tasks.clear();
+
+    Node root;
+    root.center = center;
+    root.half_size = size / 2.0;
+    root.first_body = 0;
+    root.body_count = n;
+    nodes.push_back(root);
+
+    build_top_levels(0, 0);
 
-    NW = nullptr;
-    NE = nullptr;
-    SW = nullptr;
-    SE = nullptr;
+    // subtrees differ a lot in size, so they are handed out one at a time
+    if ( task_nodes.size() < build_tasks.size() )
+    {
+        task_nodes.resize(build_tasks.size());
+    }
+
+    std::atomic<unsigned> next_task(0);
+    run_parallel(threads, [this, &next_task](unsigned)
+        {
+            for ( unsigned task = next_task++; task < build_tasks.size(); task = next_task++ )
+            {
+                std::vector<Node>& out = task_nodes[task];
+                out.clear();
+
+                const BuildTask& build_task = build_tasks[task];
+                nodes[build_task.node_index] = build_subtree(out, nodes[build_task.node_index], build_task.level);
+            }
+        });
 
-    if ( root )
+    // append the subtrees behind the top levels and turn their local child indices into global ones
+    const uint32_t top_level_count = static_cast<uint32_t>(nodes.size());
+
+    uint32_t total = top_level_count;
+    for ( unsigned task = 0; task < build_tasks.size(); ++task )
     {
-        for ( unsigned i = 0; i < bodies->get_size(); ++i )
+        build_tasks[task].offset = total;
+        total += static_cast<uint32_t>(task_nodes[task].size());
+    }
+    nodes.resize(total);
+
+    next_task = 0;
+    run_parallel(threads, [this, &next_task](unsigned)
         {
-            insert(i);
-        }
+            for ( unsigned task = next_task++; task < build_tasks.size(); task = next_task++ )
+            {
+                const uint32_t offset = build_tasks[task].offset;
+                const std::vector<Node>& local = task_nodes[task];
 
-        if ( rectangles == nullptr )
+                Node& subtree_root = nodes[build_tasks[task].node_index];
+                if ( !subtree_root.is_leaf() )
+                {
+                    subtree_root.first_child += offset - 1;
+                }
+
+                for ( uint32_t i = 0; i < local.size(); ++i )
+                {
+                    Node& node = nodes[offset + i];
+                    node = local[i];
+
+                    if ( !node.is_leaf() )
+                    {
+                        node.first_child += offset - 1;
+                    }
+                }
+            }
+        });
+
+    // the subtree roots are done, finish the few nodes above them bottom-up
+    // children always come after their parent, so walking backwards visits them first
+    for ( uint32_t i = top_level_count; i-- > 0; )
+    {
+        Node& node = nodes[i];
+        if ( !node.is_leaf() && node.first_child < top_level_count )
         {
-            rectangles = std::make_shared<sf::VertexArray>(sf::Lines, 8);
+            compute_internal_moments(node, &nodes[node.first_child]);
         }
-
-        add_root_bounds();
-        add_subdivision_bounds();
     }
-}
 
-QuadTree::QuadTree(std::shared_ptr<Bodies> bodies, double xmin, double ymin, double xmax, double ymax, std::shared_ptr<sf::VertexArray> rectangles, bool root) :
-    QuadTree(bodies, Vec2(xmin, ymin), Vec2(xmax, ymax), rectangles, root)
-{}
+    // the groups follow the morton order, so consecutive groups are neighbours in space
+    groups.clear();
+    collect_groups(0);
 
-QuadTree::~QuadTree()
+    bound_lines_dirty = true;
+    steps_since_rebuild = 0;
+    last_overlap = 0.0;
+    last_was_refit = false;
+    ++rebuild_count;
+    last_build_time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - build_start).count();
+}
+
+void QuadTree::rebuild_or_refit(Vec2 top_left, Vec2 bottom_right)
 {
-    NW = nullptr;
-    NE = nullptr;
-    SW = nullptr;
-    SE = nullptr;
+    // the topology only fits as long as no body was added or removed
+    const bool rebuild = !refit_enabled || order.size() != bodies->get_size() || ++steps_since_rebuild >= rebuild_interval
+        || last_overlap > overlap_threshold;
+
+    if ( rebuild )
+    {
+        build(top_left, bottom_right);
+    }
+    else
+    {
+        refit();
+    }
 }
 
+void QuadTree::refit()
+{
+    const auto refit_start = std::chrono::high_resolution_clock::now();
+    const unsigned n = bodies->get_size();
+    const unsigned threads = n < PARALLEL_THRESHOLD ? 1 : thread_pool->get_num_threads();
 
-/*----------------------------------------
-|             public methods             |
------------------------------------------*/
+    built_with_quadrupoles = quadrupole;
+    copy_sorted_bodies(threads);
+
+    const uint32_t top_level_count = build_tasks.empty() ? static_cast<uint32_t>(nodes.size()) : build_tasks[0].offset;
+
+    // same order as the build: the subtrees in parallel, children always after their parent
+    std::fill(thread_overlap.begin(), thread_overlap.end(), 0.0);
+    std::fill(thread_area.begin(), thread_area.end(), 0.0);
+
+    auto refit_node = [this](uint32_t i, double& overlap, double& area)
+        {
+            Node& node = nodes[i];
+            if ( node.is_leaf() )
+            {
+                fit_leaf_bounds(node);
+                compute_leaf_moments(node);
+            }
+            else
+            {
+                overlap += fit_internal_bounds(node, &nodes[node.first_child]);
+                area += 4.0 * node.half_size * node.half_size;
+                compute_internal_moments(node, &nodes[node.first_child]);
+            }
+        };
+
+    std::atomic<unsigned> next_task(0);
+    run_parallel(threads, [this, &next_task, &refit_node](unsigned t)
+        {
+            for ( unsigned task = next_task++; task < build_tasks.size(); task = next_task++ )
+            {
+                const uint32_t first = build_tasks[task].offset;
+                const uint32_t last = first + static_cast<uint32_t>(task_nodes[task].size());
+
+                for ( uint32_t i = last; i-- > first; )
+                {
+                    refit_node(i, thread_overlap[t], thread_area[t]);
+                }
+                refit_node(build_tasks[task].node_index, thread_overlap[t], thread_area[t]);
+            }
+        });
+
+    double overlap = 0.0, area = 0.0;
+    for ( uint32_t i = top_level_count; i-- > 0; )
+    {
+        if ( !nodes[i].is_leaf() && nodes[i].first_child < top_level_count )
+        {
+            refit_node(i, overlap, area);
+        }
+    }
+
+    for ( unsigned t = 0; t < thread_overlap.size(); ++t )
+    {
+        overlap += thread_overlap[t];
+        area += thread_area[t];
+    }
+
+    last_overlap = area > 0.0 ? overlap / area : 0.0;
+    last_was_refit = true;
+    ++refit_count;
+
+    bound_lines_dirty = true;
+    last_build_time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - refit_start).count();
+}
 
 void QuadTree::update(double theta, double G, double dt, unsigned long& calculations_per_frame)
 {
-    unsigned num_threads = std::thread::hardware_concurrency();
+    const unsigned n = bodies->get_size();
+    const unsigned threads = n < PARALLEL_THRESHOLD ? 1 : thread_pool->get_num_threads();
+
+    if ( body_cost.size() != n )
+    {
+        body_cost.assign(n, 1);
+        last_total_cost = n;
+    }
 
-    unsigned bodies_size = bodies->get_size();
-    unsigned bodies_per_thread = (bodies_size + num_threads - 1) / num_threads;
+    // equal group counts without balancing, equal predicted work with it
+    const unsigned num_groups = static_cast<unsigned>(groups.size());
+    compute_chunk_bounds(load_balancing ? std::min(num_groups, threads * CHUNKS_PER_THREAD) : threads);
+    const unsigned num_chunks = static_cast<unsigned>(chunk_bounds.size()) - 1;
 
-    std::vector<std::future<unsigned long>> futures(num_threads);
+    std::fill(thread_calculations.begin(), thread_calculations.end(), 0);
+    std::fill(thread_busy_time.begin(), thread_busy_time.end(), 0.0);
 
-    unsigned start = 0;
-    for ( unsigned t = 0; t < num_threads; ++t )
-    {
-        unsigned end = std::min(start + bodies_per_thread, bodies_size);
-        futures[t] = std::async(std::launch::async, [this, theta, G, calculations_per_frame, start, end]()
+    std::atomic<unsigned> next_chunk(0);
+    const auto section_start = std::chrono::high_resolution_clock::now();
+
+    // every body gets its closing kick right after its force, no separate pass over the bodies
+    const real half_step = static_cast<real>(0.5 * dt);
+
+    run_parallel(threads, [this, theta, G, half_step, num_chunks, &next_chunk](unsigned thread_index)
+        {
+            const auto start_time = std::chrono::high_resolution_clock::now();
+            unsigned long local_calculations = 0;
+            InteractionList& list = thread_lists[thread_index];
+            QuadrupoleList& cells = thread_cell_lists[thread_index];
+
+            // without balancing every thread gets exactly its own chunk
+            unsigned chunk = load_balancing ? next_chunk++ : thread_index;
+            while ( chunk < num_chunks )
             {
-                unsigned long local_calculations = 0;
-                for ( unsigned j = start; j < end; ++j )
+                for ( unsigned group = chunk_bounds[chunk]; group < chunk_bounds[chunk + 1]; ++group )
                 {
-                    bodies->acc[j] = Vec2(0, 0);
-                    compute_force(j, theta, G, local_calculations);
+                    if ( built_with_quadrupoles )
+                    {
+                        compute_group_forces<true>(nodes[groups[group]], theta, G, half_step, list, cells, local_calculations);
+                    }
+                    else
+                    {
+                        compute_group_forces<false>(nodes[groups[group]], theta, G, half_step, list, cells, local_calculations);
+                    }
                 }
-                return local_calculations;
-            });
-        start = end;
+
+                chunk = load_balancing ? next_chunk++ : num_chunks;
+            }
+
+            thread_calculations[thread_index] = local_calculations;
+            thread_busy_time[thread_index] = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+        });
+
+    const double section_time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - section_start).count();
+    last_force_time = section_time;
+
+    for ( unsigned t = 0; t < thread_busy_time.size(); ++t )
+    {
+        thread_idle_time[t] = t < threads ? std::max(0.0, section_time - thread_busy_time[t]) : 0.0;
     }
 
     unsigned long total_calculations = 0;
-    for ( auto& future : futures )
+    for ( unsigned long calculations : thread_calculations )
     {
-        total_calculations += future.get();
+        total_calculations += calculations;
     }
     calculations_per_frame = total_calculations;
+    last_total_cost = std::max(static_cast<unsigned long>(n), total_calculations);
 
-    bodies->remove_merged_bodies();
+    if ( auto_tune_leaf_capacity )
+    {
+        tune_leaf_capacity(last_build_time + last_force_time);
+    }
+}
+
+void QuadTree::set_auto_tune_leaf_capacity(bool auto_tune)
+{
+    auto_tune_leaf_capacity = auto_tune;
+
+    best_leaf_capacity = leaf_capacity;
+    best_step_time = 0.0;
+    tune_time = 0.0;
+    tune_steps = 0;
+    tune_failures = 0;
+    tune_rest = 0;
+}
+
+const std::vector<Vec2T<float>>& QuadTree::get_bounding_lines()
+{
+    // only needed when the quadtree is drawn, so the lines are generated on demand instead of during the build
+    if ( bound_lines_dirty )
+    {
+        bound_lines.clear();
+        add_root_bounds(nodes[0]);
+
+        for ( const Node& node : nodes )
+        {
+            if ( !node.is_leaf() )
+            {
+                add_subdivision_bounds(node);
+            }
+        }
+
+        bound_lines_dirty = false;
+    }
+
+    return bound_lines;
 }
 
 
@@ -92,202 +357,797 @@ void QuadTree::update(double theta, double G, double dt, unsigned long& calculat
 |             private methods            |
 -----------------------------------------*/
 
-bool QuadTree::contains(unsigned index) const
+template <typename Function>
+void QuadTree::run_parallel(unsigned threads, Function&& function)
 {
-    return bodies->pos[index].x >= top_left.x
-        && bodies->pos[index].x <= bottom_right.x
-        && bodies->pos[index].y >= top_left.y
-        && bodies->pos[index].y <= bottom_right.y;
+    if ( threads == 1 )
+    {
+        function(0u);
+        return;
+    }
+
+    thread_pool->run(function);
 }
 
-bool QuadTree::subdivide()
+void QuadTree::copy_sorted_bodies(unsigned threads)
 {
-    add_subdivision_bounds();
+    // copy the bodies in morton order, leaves then read contiguous memory during the walk
+    const unsigned n = bodies->get_size();
+    run_parallel(threads, [this, n, threads](unsigned t)
+        {
+            const unsigned start = static_cast<unsigned>(static_cast<uint64_t>(n) * t / threads);
+            const unsigned end = static_cast<unsigned>(static_cast<uint64_t>(n) * (t + 1) / threads);
+
+            for ( unsigned k = start; k < end; ++k )
+            {
+                body_pos[k] = Vec2(bodies->x[order[k]], bodies->y[order[k]]);
+                body_mass[k] = bodies->mass[order[k]];
+            }
+        });
+}
+
+void QuadTree::compute_chunk_bounds(unsigned num_chunks)
+{
+    const unsigned num_groups = static_cast<unsigned>(groups.size());
+    num_chunks = std::max(1u, num_chunks);
+
+    chunk_bounds.clear();
+    chunk_bounds.push_back(0);
+
+    if ( !load_balancing )
+    {
+        for ( unsigned chunk = 1; chunk <= num_chunks; ++chunk )
+        {
+            chunk_bounds.push_back(static_cast<uint32_t>(static_cast<uint64_t>(num_groups) * chunk / num_chunks));
+        }
+        return;
+    }
+
+    // the total of the last step is known, so one pass is enough to cut the groups into equal cost pieces.
+    // with block timesteps only the active bodies count, their total has to be summed first
+    const bool block_steps = bodies->max_time_level > 0;
+    unsigned long total_cost = last_total_cost;
+    if ( block_steps )
+    {
+        total_cost = 0;
+        for ( uint32_t k = 0; k < order.size(); ++k )
+        {
+            total_cost += bodies->is_active(order[k]) ? body_cost[order[k]] : 0;
+        }
+    }
+    const double cost_per_chunk = static_cast<double>(total_cost) / num_chunks;
 
-    Vec2 center = (this->top_left + this->bottom_right) / 2.0;
+    double accumulated = 0.0;
+    for ( unsigned group = 0; group < num_groups; ++group )
+    {
+        const Node& node = nodes[groups[group]];
+        for ( uint32_t k = node.first_body; k < node.first_body + node.body_count; ++k )
+        {
+            accumulated += !block_steps || bodies->is_active(order[k]) ? body_cost[order[k]] : 0;
+        }
 
-    this->NW = std::make_unique<QuadTree>(bodies, top_left, center, rectangles, false);
-    this->NE = std::make_unique<QuadTree>(bodies, Vec2(center.x, top_left.y), Vec2(bottom_right.x, center.y), rectangles, false);
-    this->SW = std::make_unique<QuadTree>(bodies, Vec2(top_left.x, center.y), Vec2(center.x, bottom_right.y), rectangles, false);
-    this->SE = std::make_unique<QuadTree>(bodies, center, bottom_right, rectangles, false);
+        if ( accumulated >= cost_per_chunk * chunk_bounds.size() && chunk_bounds.size() < num_chunks )
+        {
+            chunk_bounds.push_back(group + 1);
+        }
+    }
 
-    return true;
+    chunk_bounds.push_back(num_groups);
 }
 
-void QuadTree::insert(unsigned index)
+void QuadTree::tune_leaf_capacity(double step_time)
 {
-    QuadTree* current = this;
-    unsigned idx = index;
-
-    std::stack<std::pair<QuadTree*, unsigned>> stack;
-    stack.push({ current, index });
+    tune_time += step_time;
+    if ( ++tune_steps < TUNE_WINDOW )
+    {
+        return;
+    }
 
-    Vec2 adjusted_pos = bodies->pos[index] * bodies->mass[index];
+    const double average = tune_time / tune_steps;
+    tune_time = 0.0;
+    tune_steps = 0;
 
-    while ( !stack.empty() )
+    if ( tune_rest > 0 )
     {
-        current = stack.top().first;
-        idx = stack.top().second;
-        stack.pop();
+        // settled, only keep an eye on how long the best capacity takes now
+        best_step_time = average;
+        --tune_rest;
+        return;
+    }
 
-        while ( !current->is_leaf() )
+    if ( best_step_time == 0.0 || leaf_capacity == best_leaf_capacity )
+    {
+        best_step_time = average;
+    }
+    else if ( average < best_step_time )
+    {
+        best_leaf_capacity = leaf_capacity;
+        best_step_time = average;
+        tune_failures = 0;
+    }
+    else
+    {
+        // worse, try the other direction next, after both failed rest a while
+        tune_direction = -tune_direction;
+        if ( ++tune_failures >= 2 )
         {
-            current->center_of_mass = ((current->center_of_mass * current->mass) + adjusted_pos) / (current->mass + bodies->mass[idx]);
-            current->mass += bodies->mass[idx];
+            tune_failures = 0;
+            tune_rest = TUNE_REST_WINDOWS;
+            leaf_capacity = best_leaf_capacity;
+            return;
+        }
+    }
 
-            current = current->get_child_quadrant(idx);
+    // at the ends of the range there is only one direction to try
+    if ( (tune_direction > 0 && best_leaf_capacity >= MAX_LEAF_CAPACITY) || (tune_direction < 0 && best_leaf_capacity <= 1) )
+    {
+        tune_direction = -tune_direction;
+    }
+
+    leaf_capacity = std::clamp(tune_direction > 0 ? best_leaf_capacity * 2 : best_leaf_capacity / 2, 1u, MAX_LEAF_CAPACITY);
+}
+
+/*--------------------
+|   morton sorting   |
+---------------------*/
+
+// inserts a zero bit between each of the lower 16 bits
+static inline uint32_t spread_bits(uint32_t value)
+{
+    value &= 0x0000ffff;
+    value = (value | (value << 8)) & 0x00ff00ff;
+    value = (value | (value << 4)) & 0x0f0f0f0f;
+    value = (value | (value << 2)) & 0x33333333;
+    value = (value | (value << 1)) & 0x55555555;
+    return value;
+}
+
+void QuadTree::compute_keys(const Vec2& origin, double size)
+{
+    const unsigned n = bodies->get_size();
+    const unsigned threads = n < PARALLEL_THRESHOLD ? 1 : thread_pool->get_num_threads();
+
+    const double grid_size = static_cast<double>(1u << MAX_DEPTH);
+    const double scale = size > 0.0 ? grid_size / size : 0.0;
 
-            if ( current == nullptr )
+    run_parallel(threads, [this, n, threads, &origin, scale, grid_size](unsigned t)
+        {
+            const unsigned start = static_cast<unsigned>(static_cast<uint64_t>(n) * t / threads);
+            const unsigned end = static_cast<unsigned>(static_cast<uint64_t>(n) * (t + 1) / threads);
+
+            for ( unsigned i = start; i < end; ++i )
             {
-                throw std::runtime_error("Error: Body not contained in any quadrant, this should never happen lol");
+                const double gx = std::clamp((bodies->x[i] - origin.x) * scale, 0.0, grid_size - 1.0);
+                const double gy = std::clamp((bodies->y[i] - origin.y) * scale, 0.0, grid_size - 1.0);
+
+                // x in the low bit of every digit, so a digit is (east + 2 * south) like the child order
+                keys[i] = spread_bits(static_cast<uint32_t>(gx)) | (spread_bits(static_cast<uint32_t>(gy)) << 1);
+                order[i] = i;
             }
-        }
+        });
+}
+
+void QuadTree::sort_keys()
+{
+    // LSD radix sort on 8 bit digits, every thread sorts its own chunk into its own slots, so it is stable
+    const unsigned n = bodies->get_size();
+    const unsigned threads = n < PARALLEL_THRESHOLD ? 1 : thread_pool->get_num_threads();
+    constexpr unsigned RADIX = 256;
+
+    histograms.assign(threads * RADIX, 0);
+
+    for ( unsigned shift = 0; shift < 32; shift += 8 )
+    {
+        run_parallel(threads, [this, n, threads, shift](unsigned t)
+            {
+                const unsigned start = static_cast<unsigned>(static_cast<uint64_t>(n) * t / threads);
+                const unsigned end = static_cast<unsigned>(static_cast<uint64_t>(n) * (t + 1) / threads);
+
+                uint32_t* histogram = &histograms[t * RADIX];
+                std::fill(histogram, histogram + RADIX, 0);
+
+                for ( unsigned i = start; i < end; ++i )
+                {
+                    ++histogram[(keys[i] >> shift) & (RADIX - 1)];
+                }
+            });
 
-        if ( current->body_index == -1 )
+        // exclusive prefix sum, digit major and thread minor keeps the order within a digit
+        uint32_t sum = 0;
+        bool single_digit = false;
+        for ( unsigned digit = 0; digit < RADIX; ++digit )
         {
-            current->center_of_mass = bodies->pos[idx];
-            current->mass = bodies->mass[idx];
-            current->body_index = idx;
-            return;
+            const uint32_t digit_start = sum;
+            for ( unsigned t = 0; t < threads; ++t )
+            {
+                const uint32_t count = histograms[t * RADIX + digit];
+                histograms[t * RADIX + digit] = sum;
+                sum += count;
+            }
+            single_digit |= (sum - digit_start == n);
         }
 
-        else if ( current->subdivide() )
+        // all keys share this digit, nothing would move
+        if ( single_digit )
         {
-            stack.push({ current->get_child_quadrant(current->body_index), current->body_index });
-            stack.push({ current->get_child_quadrant(idx), idx });
-            current->body_index = -1;
+            continue;
         }
+
+        run_parallel(threads, [this, n, threads, shift](unsigned t)
+            {
+                const unsigned start = static_cast<unsigned>(static_cast<uint64_t>(n) * t / threads);
+                const unsigned end = static_cast<unsigned>(static_cast<uint64_t>(n) * (t + 1) / threads);
+
+                uint32_t* offsets = &histograms[t * RADIX];
+
+                for ( unsigned i = start; i < end; ++i )
+                {
+                    const uint32_t target = offsets[(keys[i] >> shift) & (RADIX - 1)]++;
+                    keys_tmp[target] = keys[i];
+                    order_tmp[target] = order[i];
+                }
+            });
+
+        std::swap(keys, keys_tmp);
+        std::swap(order, order_tmp);
     }
 }
 
-QuadTree* QuadTree::get_child_quadrant(unsigned index)
+uint32_t QuadTree::split_range(uint32_t first, uint32_t last, unsigned level, uint32_t quadrant) const
 {
-    if ( this->NW->contains(index) )
+    // all keys in [first, last) share the digits above level, so they are sorted by the digit at level
+    const unsigned shift = 2 * (MAX_DEPTH - 1 - level);
+
+    auto it = std::partition_point(keys.begin() + first, keys.begin() + last, [shift, quadrant](uint32_t key)
+        {
+            return ((key >> shift) & 3) <= quadrant;
+        });
+
+    return static_cast<uint32_t>(it - keys.begin());
+}
+
+/*--------------------
+|   tree building    |
+---------------------*/
+
+void QuadTree::build_top_levels(uint32_t node_index, unsigned level)
+{
+    const Node node = nodes[node_index];
+
+    if ( level == SPLIT_LEVEL || node.body_count <= leaf_capacity )
     {
-        return this->NW.get();
+        build_tasks.push_back({ node_index, level, 0 });
+        return;
     }
-    else if ( this->NE->contains(index) )
+
+    const uint32_t first_child = static_cast<uint32_t>(nodes.size());
+    nodes.resize(first_child + 4);
+    nodes[node_index].first_child = first_child;
+
+    const real half = node.half_size / 2;
+    const uint32_t last = node.first_body + node.body_count;
+
+    uint32_t first = node.first_body;
+    for ( uint32_t quadrant = 0; quadrant < 4; ++quadrant )
     {
-        return this->NE.get();
+        const uint32_t end = quadrant == 3 ? last : split_range(first, last, level, quadrant);
+
+        Node& child = nodes[first_child + quadrant];
+        child.center = node.center + Vec2(quadrant & 1 ? half : -half, quadrant & 2 ? half : -half);
+        child.half_size = half;
+        child.first_body = first;
+        child.body_count = end - first;
+
+        first = end;
     }
-    else if ( this->SW->contains(index) )
+
+    for ( uint32_t quadrant = 0; quadrant < 4; ++quadrant )
     {
-        return this->SW.get();
+        build_top_levels(first_child + quadrant, level + 1);
     }
-    else if ( this->SE->contains(index) )
+}
+
+QuadTree::Node QuadTree::build_subtree(std::vector<Node>& out, Node node, unsigned level)
+{
+    if ( node.body_count <= leaf_capacity || level == MAX_DEPTH )
     {
-        return this->SE.get();
+        compute_leaf_moments(node);
+        return node;
     }
-    else
+
+    const uint32_t first_child = static_cast<uint32_t>(out.size());
+    out.resize(first_child + 4);
+
+    const real half = node.half_size / 2;
+    const uint32_t last = node.first_body + node.body_count;
+
+    uint32_t first = node.first_body;
+    for ( uint32_t quadrant = 0; quadrant < 4; ++quadrant )
     {
-        throw std::runtime_error("Error: Body not contained in any quadrant, this should never happen lol");
+        const uint32_t end = quadrant == 3 ? last : split_range(first, last, level, quadrant);
+
+        Node child;
+        child.center = node.center + Vec2(quadrant & 1 ? half : -half, quadrant & 2 ? half : -half);
+        child.half_size = half;
+        child.first_body = first;
+        child.body_count = end - first;
+
+        // the recursion grows out, so only index into it afterwards
+        const Node built = build_subtree(out, child, level + 1);
+        out[first_child + quadrant] = built;
+
+        first = end;
     }
+
+    compute_internal_moments(node, &out[first_child]);
+
+    // local index + 1 so that 0 still means leaf, build() moves it to the global index
+    node.first_child = first_child + 1;
+    return node;
 }
 
-void QuadTree::compute_force(unsigned index, double theta, double G, unsigned long& calculations_per_frame)
+void QuadTree::compute_leaf_moments(Node& node) const
 {
-    double theta_squared = theta * theta;
+    Vec2T<accumulator> weighted_pos(0, 0);
+    accumulator mass = 0;
+
+    for ( uint32_t k = node.first_body; k < node.first_body + node.body_count; ++k )
+    {
+        weighted_pos += Vec2T<accumulator>(body_pos[k]) * body_mass[k];
+        mass += body_mass[k];
+    }
 
-    std::stack<QuadTree*> stack;
-    QuadTree* current = this;
-    stack.push(this);
+    node.mass = static_cast<real>(mass);
+    node.center_of_mass = mass > 0 ? Vec2(weighted_pos / mass) : node.center;
 
-    while ( !stack.empty() )
+    if ( built_with_quadrupoles )
     {
-        current = stack.top();
-        stack.pop();
+        accumulator xx = 0, xy = 0, yy = 0;
+        for ( uint32_t k = node.first_body; k < node.first_body + node.body_count; ++k )
+        {
+            const Vec2 d = body_pos[k] - node.center_of_mass;
+            xx += body_mass[k] * d.x * d.x;
+            xy += body_mass[k] * d.x * d.y;
+            yy += body_mass[k] * d.y * d.y;
+        }
+
+        node.quad_xx = xx;
+        node.quad_xy = xy;
+        node.quad_yy = yy;
+    }
+}
 
-        if ( current->mass == 0 || current->body_index == index )
+void QuadTree::compute_internal_moments(Node& node, const Node* children) const
+{
+    Vec2T<accumulator> weighted_pos(0, 0);
+    accumulator mass = 0;
+
+    for ( unsigned quadrant = 0; quadrant < 4; ++quadrant )
+    {
+        weighted_pos += Vec2T<accumulator>(children[quadrant].center_of_mass) * children[quadrant].mass;
+        mass += children[quadrant].mass;
+    }
+
+    node.mass = static_cast<real>(mass);
+    node.center_of_mass = mass > 0 ? Vec2(weighted_pos / mass) : node.center;
+
+    if ( built_with_quadrupoles )
+    {
+        // parallel axis theorem, move the moments of every child to the new center of mass
+        accumulator xx = 0, xy = 0, yy = 0;
+        for ( unsigned quadrant = 0; quadrant < 4; ++quadrant )
         {
-            continue;
+            const Node& child = children[quadrant];
+            const Vec2 d = child.center_of_mass - node.center_of_mass;
+            xx += child.quad_xx + child.mass * d.x * d.x;
+            xy += child.quad_xy + child.mass * d.x * d.y;
+            yy += child.quad_yy + child.mass * d.y * d.y;
         }
 
-        const Vec2 direction = current->center_of_mass - bodies->pos[index];
-        const double squared_distance = direction.squared_length();
+        node.quad_xx = xx;
+        node.quad_xy = xy;
+        node.quad_yy = yy;
+    }
+}
 
-        if ( squared_distance == 0 )
+void QuadTree::fit_leaf_bounds(Node& node) const
+{
+    if ( node.body_count == 0 )
+    {
+        return;
+    }
+
+    Vec2 box_min = body_pos[node.first_body];
+    Vec2 box_max = body_pos[node.first_body];
+    for ( uint32_t k = node.first_body + 1; k < node.first_body + node.body_count; ++k )
+    {
+        box_min.x = std::min(box_min.x, body_pos[k].x);
+        box_min.y = std::min(box_min.y, body_pos[k].y);
+        box_max.x = std::max(box_max.x, body_pos[k].x);
+        box_max.y = std::max(box_max.y, body_pos[k].y);
+    }
+
+    node.center = (box_min + box_max) / 2;
+    node.half_size = std::max(box_max.x - box_min.x, box_max.y - box_min.y) / 2;
+}
+
+double QuadTree::fit_internal_bounds(Node& node, const Node* children) const
+{
+    // bounding square of the children, returns how much area the children share
+    Vec2 box_min(0.0, 0.0), box_max(0.0, 0.0);
+    bool first = true;
+    double overlap = 0.0;
+
+    for ( unsigned quadrant = 0; quadrant < 4; ++quadrant )
+    {
+        const Node& child = children[quadrant];
+        if ( child.body_count == 0 )
         {
             continue;
         }
 
-        const double squared_size = (current->bottom_right - current->top_left).squared_length();
-        const double size_ratio = squared_size / squared_distance;
+        const Vec2 child_min = child.center - Vec2(child.half_size, child.half_size);
+        const Vec2 child_max = child.center + Vec2(child.half_size, child.half_size);
+
+        box_min = first ? child_min : Vec2(std::min(box_min.x, child_min.x), std::min(box_min.y, child_min.y));
+        box_max = first ? child_max : Vec2(std::max(box_max.x, child_max.x), std::max(box_max.y, child_max.y));
+        first = false;
 
-        if ( size_ratio < theta_squared || current->is_leaf() )
+        for ( unsigned other = quadrant + 1; other < 4; ++other )
         {
-            ++calculations_per_frame;
-            double force = calculate_gravitational_force(G, current->mass, bodies->mass[index], squared_distance);
-            bodies->add_force(index, direction * force);
+            const Node& sibling = children[other];
+            if ( sibling.body_count == 0 )
+            {
+                continue;
+            }
+
+            const double width = std::min(child_max.x, sibling.center.x + sibling.half_size) - std::max(child_min.x, sibling.center.x - sibling.half_size);
+            const double height = std::min(child_max.y, sibling.center.y + sibling.half_size) - std::max(child_min.y, sibling.center.y - sibling.half_size);
+            overlap += std::max(0.0, width) * std::max(0.0, height);
         }
-        else
+    }
+
+    node.center = (box_min + box_max) / 2;
+    node.half_size = std::max(box_max.x - box_min.x, box_max.y - box_min.y) / 2;
+    return overlap;
+}
+
+/*--------------------
+|   force methods    |
+---------------------*/
+
+template <bool QUADRUPOLE>
+void QuadTree::collect_interactions(const Vec2& box_min, const Vec2& box_max, real theta_squared, InteractionList& list, QuadrupoleList& cells) const
+{
+    // bodies of the group itself end up in the list too, that is fine since a body adds exactly 0 to itself (d = 0)
+    if ( nodes[0].is_leaf() )
+    {
+        for ( uint32_t k = 0; k < nodes[0].body_count; ++k )
         {
-            if ( current->NE != nullptr )
+            list.push(body_pos[k].x, body_pos[k].y, body_mass[k]);
+        }
+        return;
+    }
+
+    // the opening test is done on all four children of an opened node at once, only opened cells go on the stack.
+    // every pop pushes at most 4 nodes one level deeper, so this can never overflow
+    uint32_t stack[3 * MAX_DEPTH + 4];
+    unsigned stack_size = 0;
+    stack[stack_size++] = 0;
+
+    while ( stack_size > 0 )
+    {
+        const Node& current = nodes[stack[--stack_size]];
+
+        list.reserve_more(4);
+        if constexpr ( QUADRUPOLE )
+        {
+            cells.reserve_more(4);
+        }
+
+        for ( uint32_t child_index = current.first_child; child_index < current.first_child + 4; ++child_index )
+        {
+            const Node& child = nodes[child_index];
+
+            // distance from the center of mass to the closest point of the group box, every member is at least this far away
+            const real dx = std::max(real(0), std::max(box_min.x - child.center_of_mass.x, child.center_of_mass.x - box_max.x));
+            const real dy = std::max(real(0), std::max(box_min.y - child.center_of_mass.y, child.center_of_mass.y - box_max.y));
+            const real squared_distance = dx * dx + dy * dy;
+
+            // squared diagonal of the cell, after a refit the children are no longer equally large
+            const real squared_size = 8 * child.half_size * child.half_size;
+
+            // a single body is exact, no matter how close it is
+            const bool accepted = child.body_count == 1 || squared_size < theta_squared * squared_distance;
+            const bool empty = child.body_count == 0;
+
+            if ( accepted || empty )
+            {
+                // branch free, the slot is simply overwritten when the cell is not accepted
+                if constexpr ( QUADRUPOLE )
+                {
+                    cells.push_unchecked(child.center_of_mass.x, child.center_of_mass.y, child.mass, child.quad_xx, child.quad_xy, child.quad_yy, !empty);
+                }
+                else
+                {
+                    list.push_unchecked(child.center_of_mass.x, child.center_of_mass.y, child.mass, !empty);
+                }
+            }
+            else if ( child.is_leaf() )
+            {
+                list.reserve_more(child.body_count + 4);
+                for ( uint32_t k = child.first_body; k < child.first_body + child.body_count; ++k )
+                {
+                    list.push_unchecked(body_pos[k].x, body_pos[k].y, body_mass[k], true);
+                }
+            }
+            else
             {
-                stack.push(current->NE.get());
-                stack.push(current->NW.get());
-                stack.push(current->SE.get());
-                stack.push(current->SW.get());
+                stack[stack_size++] = child_index;
             }
         }
     }
 }
 
+template <bool QUADRUPOLE>
+void QuadTree::compute_group_forces(const Node& group, double theta, double G, real half_step, InteractionList& list, QuadrupoleList& cells, unsigned long& calculations_per_frame)
+{
+    const uint32_t first = group.first_body;
+    const uint32_t last = group.first_body + group.body_count;
 
-double QuadTree::calculate_gravitational_force(double G, double mass1, double mass2, double squared_distance) const
+    // tight box around the members, the cell itself can be a lot larger.
+    // with block timesteps only the active members need a force, so only they go into the box
+    Vec2 box_min, box_max;
+    unsigned active = 0;
+    for ( uint32_t k = first; k < last; ++k )
+    {
+        if ( !bodies->is_active(order[k]) )
+        {
+            continue;
+        }
+
+        box_min = active == 0 ? body_pos[k] : Vec2(std::min(box_min.x, body_pos[k].x), std::min(box_min.y, body_pos[k].y));
+        box_max = active == 0 ? body_pos[k] : Vec2(std::max(box_max.x, body_pos[k].x), std::max(box_max.y, body_pos[k].y));
+        ++active;
+    }
+
+    if ( active == 0 )
+    {
+        return;
+    }
+
+    // one walk for the whole group, then every member evaluates the same list
+    list.clear();
+    cells.clear();
+    collect_interactions<QUADRUPOLE>(box_min, box_max, static_cast<real>(theta * theta), list, cells);
+    list.pad();
+    if constexpr ( QUADRUPOLE )
+    {
+        cells.pad();
+    }
+
+    const unsigned interactions = list.size() + (QUADRUPOLE ? cells.size() : 0);
+
+    for ( uint32_t k = first; k < last; ++k )
+    {
+        const uint32_t index = order[k];
+        if ( !bodies->is_active(index) )
+        {
+            continue;
+        }
+
+        accumulator acc_x, acc_y;
+        evaluate_interactions(list, body_pos[k].x, body_pos[k].y, acc_x, acc_y);
+        if constexpr ( QUADRUPOLE )
+        {
+            evaluate_quadrupoles(cells, body_pos[k].x, body_pos[k].y, acc_x, acc_y);
+        }
+
+        bodies->finish_step(index, static_cast<real>(G * acc_x), static_cast<real>(G * acc_y), half_step);
+        body_cost[index] = std::max(1u, interactions);
+    }
+
+    calculations_per_frame += static_cast<unsigned long>(interactions) * active;
+}
+
+/*--------------------
+| collision methods  |
+---------------------*/
+
+void QuadTree::remap_bodies(const std::vector<uint32_t>& remap)
 {
-    const double epsilon_squared = 2.0;    // softening factor, else force goes BRRRRRT
-    return G * mass1 * mass2 / (squared_distance + epsilon_squared);
+    if ( body_cost.size() != remap.size() )
+        return;
+
+    // the remap never moves a body up, so this works in place
+    unsigned kept = 0;
+    for ( uint32_t i = 0; i < remap.size(); ++i )
+    {
+        if ( remap[i] != Bodies::REMOVED )
+        {
+            body_cost[remap[i]] = body_cost[i];
+            ++kept;
+        }
+    }
+
+    body_cost.resize(kept);
 }
 
+void QuadTree::find_collisions(std::vector<std::pair<uint32_t, uint32_t>>& pairs)
+{
+    const unsigned n = static_cast<unsigned>(order.size());
+    const unsigned threads = n < PARALLEL_THRESHOLD ? 1 : thread_pool->get_num_threads();
+
+    pairs.clear();
+    if ( n == 0 || n != bodies->get_size() )
+    {
+        return;
+    }
 
-/*----------------------------------------
-|              bound methods             |
------------------------------------------*/
+    // radii next to the positions, the largest one bounds how far away a partner can be
+    body_radius.resize(n);
+    run_parallel(threads, [this, n, threads](unsigned t)
+        {
+            const unsigned start = static_cast<unsigned>(static_cast<uint64_t>(n) * t / threads);
+            const unsigned end = static_cast<unsigned>(static_cast<uint64_t>(n) * (t + 1) / threads);
+
+            real max_radius = 0;
+            for ( unsigned k = start; k < end; ++k )
+            {
+                body_radius[k] = bodies->radius[order[k]];
+                max_radius = std::max(max_radius, body_radius[k]);
+            }
+            thread_max_radius[t] = max_radius;
+        });
+
+    const real max_radius = *std::max_element(thread_max_radius.begin(), thread_max_radius.begin() + threads);
+
+    // every thread keeps its own pairs, the sort afterwards makes the result independent of the scheduling
+    std::atomic<unsigned> next_group(0);
+    run_parallel(threads, [this, max_radius, &next_group](unsigned t)
+        {
+            thread_collisions[t].clear();
+            for ( unsigned group = next_group++; group < groups.size(); group = next_group++ )
+            {
+                collect_collisions(nodes[groups[group]], max_radius, thread_candidates[t], thread_collisions[t]);
+            }
+        });
+
+    for ( unsigned t = 0; t < threads; ++t )
+    {
+        pairs.insert(pairs.end(), thread_collisions[t].begin(), thread_collisions[t].end());
+    }
+    std::sort(pairs.begin(), pairs.end());
+}
 
-void QuadTree::add_subdivision_bounds()
+void QuadTree::collect_collisions(const Node& group, real max_radius, std::vector<uint32_t>& candidates, std::vector<std::pair<uint32_t, uint32_t>>& found) const
 {
-    sf::Vertex vertex;
-    vertex.color = color;
+    const uint32_t first = group.first_body;
+    const uint32_t last = group.first_body + group.body_count;
 
-    vertex.position = sf::Vector2f((bottom_right.x + top_left.x) / 2.0f, top_left.y);
-    rectangles->append(vertex);
+    // box around the members, grown by their own largest radius plus the largest one overall
+    Vec2 box_min = body_pos[first];
+    Vec2 box_max = body_pos[first];
+    real reach = 0;
+    for ( uint32_t k = first; k < last; ++k )
+    {
+        box_min = Vec2(std::min(box_min.x, body_pos[k].x), std::min(box_min.y, body_pos[k].y));
+        box_max = Vec2(std::max(box_max.x, body_pos[k].x), std::max(box_max.y, body_pos[k].y));
+        reach = std::max(reach, body_radius[k]);
+    }
+    reach += max_radius;
+    box_min -= Vec2(reach, reach);
+    box_max += Vec2(reach, reach);
 
-    vertex.position = sf::Vector2f((bottom_right.x + top_left.x) / 2.0f, bottom_right.y);
-    rectangles->append(vertex);
+    // every body of a leaf that touches the box is a candidate, the group itself included
+    candidates.clear();
 
-    vertex.position = sf::Vector2f(top_left.x, (bottom_right.y + top_left.y) / 2.0f);
-    rectangles->append(vertex);
+    uint32_t stack[3 * MAX_DEPTH + 4];
+    unsigned stack_size = 0;
+    stack[stack_size++] = 0;
 
-    vertex.position = sf::Vector2f(bottom_right.x, (bottom_right.y + top_left.y) / 2.0f);
-    rectangles->append(vertex);
+    while ( stack_size > 0 )
+    {
+        const uint32_t node_index = stack[--stack_size];
+        const Node& node = nodes[node_index];
+
+        const bool outside = node.center.x + node.half_size < box_min.x || node.center.x - node.half_size > box_max.x
+            || node.center.y + node.half_size < box_min.y || node.center.y - node.half_size > box_max.y;
+
+        if ( node.body_count == 0 || outside )
+        {
+            continue;
+        }
+
+        if ( node.is_leaf() )
+        {
+            for ( uint32_t k = node.first_body; k < node.first_body + node.body_count; ++k )
+            {
+                candidates.push_back(k);
+            }
+        }
+        else
+        {
+            for ( uint32_t quadrant = 0; quadrant < 4; ++quadrant )
+            {
+                stack[stack_size++] = node.first_child + quadrant;
+            }
+        }
+    }
+
+    for ( uint32_t k = first; k < last; ++k )
+    {
+        for ( uint32_t j : candidates )
+        {
+            // every pair once, from the member with the lower morton index
+            if ( j <= k )
+            {
+                continue;
+            }
+
+            const Vec2 d = body_pos[j] - body_pos[k];
+            const real touching = body_radius[k] + body_radius[j];
+            if ( d.squared_length() < touching * touching )
+            {
+                found.push_back(std::minmax(order[k], order[j]));
+            }
+        }
+    }
 }
 
-void QuadTree::add_root_bounds()
+void QuadTree::collect_groups(uint32_t node_index)
 {
-    sf::Vertex vertex;
-    vertex.color = color;
+    const Node& node = nodes[node_index];
+
+    if ( node.body_count == 0 )
+    {
+        return;
+    }
+
+    if ( node.body_count <= group_size || node.is_leaf() )
+    {
+        groups.push_back(node_index);
+        return;
+    }
+
+    for ( uint32_t quadrant = 0; quadrant < 4; ++quadrant )
+    {
+        collect_groups(node.first_child + quadrant);
+    }
+}
+
+
+/*----------------------------------------
+|              bound methods             |
+-----------------------------------------*/
 
-    vertex.position = sf::Vector2f(top_left.x, top_left.y);
-    rectangles->append(vertex);
+void QuadTree::add_subdivision_bounds(const Node& node)
+{
+    const Vec2 top_left = node.center - Vec2(node.half_size, node.half_size);
+    const Vec2 bottom_right = node.center + Vec2(node.half_size, node.half_size);
 
-    vertex.position = sf::Vector2f(bottom_right.x, top_left.y);
-    rectangles->append(vertex);
+    // the cross through the center
+    bound_lines.emplace_back(node.center.x, top_left.y);
+    bound_lines.emplace_back(node.center.x, bottom_right.y);
 
-    vertex.position = sf::Vector2f(bottom_right.x, top_left.y);
-    rectangles->append(vertex);
+    bound_lines.emplace_back(top_left.x, node.center.y);
+    bound_lines.emplace_back(bottom_right.x, node.center.y);
+}
 
-    vertex.position = sf::Vector2f(bottom_right.x, bottom_right.y);
-    rectangles->append(vertex);
+void QuadTree::add_root_bounds(const Node& node)
+{
+    const Vec2 top_left = node.center - Vec2(node.half_size, node.half_size);
+    const Vec2 bottom_right = node.center + Vec2(node.half_size, node.half_size);
 
-    vertex.position = sf::Vector2f(bottom_right.x, bottom_right.y);
-    rectangles->append(vertex);
+    bound_lines.emplace_back(top_left.x, top_left.y);
+    bound_lines.emplace_back(bottom_right.x, top_left.y);
 
-    vertex.position = sf::Vector2f(top_left.x, bottom_right.y);
-    rectangles->append(vertex);
+    bound_lines.emplace_back(bottom_right.x, top_left.y);
+    bound_lines.emplace_back(bottom_right.x, bottom_right.y);
 
-    vertex.position = sf::Vector2f(top_left.x, bottom_right.y);
-    rectangles->append(vertex);
+    bound_lines.emplace_back(bottom_right.x, bottom_right.y);
+    bound_lines.emplace_back(top_left.x, bottom_right.y);
 
-    vertex.position = sf::Vector2f(top_left.x, top_left.y);
-    rectangles->append(vertex);
-}
\ No newline at end of file
+    bound_lines.emplace_back(top_left.x, bottom_right.y);
+    bound_lines.emplace_back(top_left.x, top_left.y);
+}
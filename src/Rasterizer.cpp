@@ -0,0 +1,226 @@
+#include "Rasterizer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+void density_color(double t, uint8_t& r, uint8_t& g, uint8_t& b)
+{
+    static constexpr double interpolation_cutoff = 0.5;
+
+    static constexpr double low_density_color[3] = { 0, 128, 255 };     // Light blue
+    static constexpr double mid_density_color[3] = { 255, 0, 255 };     // Magenta
+    static constexpr double high_density_color[3] = { 255, 255, 0 };    // Yellow
+
+    t = std::clamp(t, 0.0, 1.0);
+    const bool low = t < interpolation_cutoff;
+
+    const double t2 = low ? t / interpolation_cutoff : (t - interpolation_cutoff) / (1 - interpolation_cutoff);
+    const double* from = low ? low_density_color : mid_density_color;
+    const double* to = low ? mid_density_color : high_density_color;
+
+    r = static_cast<uint8_t>(from[0] * (1.0 - t2) + to[0] * t2);
+    g = static_cast<uint8_t>(from[1] * (1.0 - t2) + to[1] * t2);
+    b = static_cast<uint8_t>(from[2] * (1.0 - t2) + to[2] * t2);
+}
+
+/*----------------------------------------
+|         Constructor/Destructor         |
+-----------------------------------------*/
+
+Rasterizer::Rasterizer(unsigned width, unsigned height)
+    : width(width), height(height)
+{
+    tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+    tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+    num_tiles = tiles_x * tiles_y;
+
+    counts.resize(static_cast<std::size_t>(width) * height);
+    tile_offsets.resize(num_tiles + 1);
+
+    set_view(0.0, 0.0, width, height);
+}
+
+/*----------------------------------------
+|             public methods             |
+-----------------------------------------*/
+
+void Rasterizer::set_view(double left, double top, double view_width, double view_height)
+{
+    this->left = left;
+    this->top = top;
+    scale_x = width / view_width;
+    scale_y = height / view_height;
+}
+
+void Rasterizer::render(ThreadPool& pool, const real* x, const real* y, unsigned count, uint8_t* rgba)
+{
+    const std::chrono::high_resolution_clock::time_point start_time = std::chrono::high_resolution_clock::now();
+
+    bin_bodies(pool, x, y, count);
+    count_tiles(pool);
+    tone_map(pool, rgba);
+
+    render_time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+}
+
+/*----------------------------------------
+|            private methods             |
+-----------------------------------------*/
+
+void Rasterizer::bin_bodies(ThreadPool& pool, const real* x, const real* y, unsigned count)
+{
+    const unsigned num_threads = pool.get_num_threads();
+
+    keys.resize(count);
+    thread_offsets.assign(static_cast<std::size_t>(num_threads) * num_tiles, 0);
+
+    // bodies per tile and thread
+    pool.parallel_for(0, count, [&](unsigned start, unsigned end, unsigned thread_index)
+        {
+            uint32_t* histogram = &thread_offsets[static_cast<std::size_t>(thread_index) * num_tiles];
+
+            for ( unsigned i = start; i < end; ++i )
+            {
+                const double px = (x[i] - left) * scale_x;
+                const double py = (y[i] - top) * scale_y;
+
+                // also drops nan
+                if ( !(px >= 0.0 && px < width && py >= 0.0 && py < height) )
+                {
+                    keys[i] = OUTSIDE;
+                    continue;
+                }
+
+                const unsigned ix = static_cast<unsigned>(px);
+                const unsigned iy = static_cast<unsigned>(py);
+                const uint32_t tile = (iy / TILE_SIZE) * tiles_x + ix / TILE_SIZE;
+
+                keys[i] = (tile << TILE_BITS) | ((iy % TILE_SIZE) * TILE_SIZE + ix % TILE_SIZE);
+                ++histogram[tile];
+            }
+        });
+
+    // tile by tile, and within a tile thread by thread, so every thread writes to its own part of each tile
+    uint32_t offset = 0;
+    for ( unsigned tile = 0; tile < num_tiles; ++tile )
+    {
+        tile_offsets[tile] = offset;
+        for ( unsigned thread = 0; thread < num_threads; ++thread )
+        {
+            uint32_t& slot = thread_offsets[static_cast<std::size_t>(thread) * num_tiles + tile];
+            const uint32_t bodies = slot;
+            slot = offset;
+            offset += bodies;
+        }
+    }
+    tile_offsets[num_tiles] = offset;
+
+    sorted.resize(offset);
+
+    // the same range and chunks as above, so each thread gets the bodies it counted
+    pool.parallel_for(0, count, [&](unsigned start, unsigned end, unsigned thread_index)
+        {
+            uint32_t* next = &thread_offsets[static_cast<std::size_t>(thread_index) * num_tiles];
+
+            for ( unsigned i = start; i < end; ++i )
+            {
+                const uint32_t key = keys[i];
+                if ( key == OUTSIDE )
+                    continue;
+
+                sorted[next[key >> TILE_BITS]++] = static_cast<uint16_t>(key & ((1u << TILE_BITS) - 1));
+            }
+        });
+}
+
+void Rasterizer::count_tiles(ThreadPool& pool)
+{
+    const unsigned num_threads = pool.get_num_threads();
+    thread_max.assign(num_threads, 0);
+
+    // a contiguous run of tiles per thread, split so that every thread counts about as many bodies and clears as many tiles
+    const uint64_t total_cost = tile_offsets[num_tiles] + static_cast<uint64_t>(num_tiles) * TILE_COST;
+    const auto first_tile = [&](unsigned thread_index)
+        {
+            const uint64_t cost = total_cost * thread_index / num_threads;
+            unsigned low = 0, high = num_tiles;
+            while ( low < high )
+            {
+                const unsigned middle = (low + high) / 2;
+                if ( tile_offsets[middle] + static_cast<uint64_t>(middle) * TILE_COST < cost )
+                    low = middle + 1;
+                else
+                    high = middle;
+            }
+            return low;
+        };
+
+    pool.run([&](unsigned thread_index)
+        {
+            const unsigned begin = first_tile(thread_index);
+            const unsigned end = thread_index + 1 == num_threads ? num_tiles : first_tile(thread_index + 1);
+            uint32_t highest = 0;
+
+            for ( unsigned tile = begin; tile < end; ++tile )
+            {
+                const unsigned tile_x = (tile % tiles_x) * TILE_SIZE;
+                const unsigned tile_y = (tile / tiles_x) * TILE_SIZE;
+                const unsigned tile_width = std::min(TILE_SIZE, width - tile_x);
+                const unsigned tile_height = std::min(TILE_SIZE, height - tile_y);
+
+                uint32_t* origin = &counts[static_cast<std::size_t>(tile_y) * width + tile_x];
+                for ( unsigned row = 0; row < tile_height; ++row )
+                {
+                    std::fill(origin + static_cast<std::size_t>(row) * width, origin + static_cast<std::size_t>(row) * width + tile_width, 0);
+                }
+
+                for ( uint32_t j = tile_offsets[tile]; j < tile_offsets[tile + 1]; ++j )
+                {
+                    const unsigned pixel = sorted[j];
+                    const uint32_t count = ++origin[(pixel / TILE_SIZE) * width + pixel % TILE_SIZE];
+                    highest = std::max(highest, count);
+                }
+            }
+
+            thread_max[thread_index] = highest;
+        });
+
+    highest_count = *std::max_element(thread_max.begin(), thread_max.end());
+}
+
+void Rasterizer::tone_map(ThreadPool& pool, uint8_t* rgba)
+{
+    const double scale = highest_count > 0 ? 1.0 / std::log1p(static_cast<double>(highest_count)) : 0.0;
+    const auto color = [scale](uint32_t count)
+        {
+            uint8_t pixel[4] = { 0, 0, 0, 255 };
+            if ( count > 0 )
+            {
+                density_color(std::log1p(static_cast<double>(count)) * scale, pixel[0], pixel[1], pixel[2]);
+            }
+
+            uint32_t packed;
+            std::memcpy(&packed, pixel, 4);
+            return packed;
+        };
+
+    // only the few brightest pixels of a dense core are above the table
+    color_table.resize(std::min<uint32_t>(highest_count + 1, COLOR_TABLE_SIZE));
+    for ( uint32_t count = 0; count < color_table.size(); ++count )
+    {
+        color_table[count] = color(count);
+    }
+
+    const uint32_t table_size = static_cast<uint32_t>(color_table.size());
+    pool.parallel_for(0, width * height, [&](unsigned start, unsigned end, unsigned)
+        {
+            for ( unsigned i = start; i < end; ++i )
+            {
+                const uint32_t count = counts[i];
+                const uint32_t packed = count < table_size ? color_table[count] : color(count);
+                std::memcpy(rgba + 4 * static_cast<std::size_t>(i), &packed, 4);
+            }
+        }, 16384);
+}
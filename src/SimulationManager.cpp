@@ -5,32 +5,65 @@
 |         Constructor/Destructor         |
 -----------------------------------------*/
 
-SimulationManager::SimulationManager(const int width, const int height, const char* title, double G, double theta, double dt)
-    : G(G), theta(theta), dt(dt), paused(true), draw_quadtree(false), draw_vectors(false), debug(false), total_calculations(0)
+SimulationManager::SimulationManager(const int width, const int height, const char* title, double G, double theta, double dt, unsigned num_threads, bool pin_threads)
+    : G(G), theta(theta), dt(dt), paused(true), draw_quadtree(false), draw_vectors(false), debug(false), toggle_verbose(false), total_calculations(0)
 {
     double xmin = 0.0;
     double ymin = 0.0;
     double xmax = static_cast<double>(width);
     double ymax = static_cast<double>(height);
 
+    // every parallel part of a step runs on these threads, none are created after this
+    thread_pool = std::make_shared<ThreadPool>(num_threads, pin_threads);
+
     bodies = std::make_shared<Bodies>(1000);
     bodies->set_size(width, height);
 
-    std::shared_ptr<sf::VertexArray> rectangles = std::make_shared<sf::VertexArray>(sf::Lines, 0);
-    tree = std::make_shared<QuadTree>(bodies, xmin, ymin, xmax, ymax, rectangles, true);
-
-    particle_manager = std::make_shared<ParticleManager>(bodies, width, height);
-
-    window = nullptr;
+    tree = std::make_shared<QuadTree>(bodies, thread_pool, xmin, ymin, xmax, ymax);
+    fast_multipole = std::make_shared<FastMultipole>(tree, thread_pool);
+
+    particle_manager = std::make_shared<ParticleManager>(bodies, width, height, thread_pool);
+
+    force_method = BARNES_HUT;
+    inactive_leaf_capacity = 32;
+    accelerations_valid = false;
+    average_ratio_best_case = 0.0;
+    average_ratio_worst_case = 0.0;
+    calc_best_case = 0.0;
+    calc_worst_case = 0.0;
+    active_fraction = 1.0;
+    forces_per_body = 1.0;
+    collisions = false;
+    last_merges = 0;
+    total_merges = 0;
     steps = 0;
+    calculations_per_frame = 0;
+    elapsed_time_physics = 0;
+    snapshots_enabled = false;
+    snapshot_dirty = true;
+    time_rate = 0.0;
+    max_catch_up_steps = DEFAULT_MAX_CATCH_UP_STEPS;
+    time_accumulator = 0.0;
+    simulated_time = 0.0;
+    dropped_time = 0.0;
+    published_time = 0.0;
+    shade_range_valid = false;
+    shade_lowest = 0.0;
+    shade_highest = 0.0;
+    last_advance = std::chrono::steady_clock::now();
+    checkpoint_path = "checkpoint.gsim";
+    checkpoint_interval = 0;
+    record_path = "trajectory.gtraj";
+    record_interval = 1;
 }
 
 SimulationManager::~SimulationManager()
 {
     bodies = nullptr;
+    fast_multipole = nullptr;
     tree = nullptr;
     particle_manager = nullptr;
-    window = nullptr;
+    thread_pool = nullptr;
 }
 
 
@@ -38,88 +71,441 @@ SimulationManager::~SimulationManager()
 |             public methods             |
 -----------------------------------------*/
 
-void SimulationManager::run()
+void SimulationManager::step()
 {
-    std::chrono::high_resolution_clock::time_point start_time;
+    run_commands();
+
+    if ( !paused )
+    {
+        physics_step();
+        published_time += dt;
+    }
 
-    while ( window->is_open() )
+    if ( snapshots_enabled && snapshot_dirty )
     {
-        this->calculations_per_frame = 0;
-        elapsed_time_physics = 0;
+        publish_snapshot();
+        snapshot_dirty = false;
+    }
+}
+
+double SimulationManager::advance()
+{
+    run_commands();
+
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    const double elapsed = std::chrono::duration<double>(now - last_advance).count();
+    last_advance = now;
 
+    if ( paused || time_rate <= 0.0 )
+    {
+        // nothing builds up while paused, free running simply steps as fast as it can
+        time_accumulator = 0.0;
         if ( !paused )
         {
-            ++steps;
+            physics_step();
+            published_time += dt;
+        }
+    }
+    else
+    {
+        time_accumulator += elapsed * time_rate;
 
-            start_time = std::chrono::high_resolution_clock::now();
-            update_simulation();
+        // steps that are due, everything beyond the catch up budget is dropped. the simulation then runs slower
+        // than the rate, but the snapshots keep coming instead of falling further and further behind
+        unsigned due = static_cast<unsigned>(time_accumulator / dt);
+        if ( due > max_catch_up_steps )
+        {
+            dropped_time += (due - max_catch_up_steps) * dt;
+            time_accumulator -= (due - max_catch_up_steps) * dt;
+            due = max_catch_up_steps;
+        }
 
-            elapsed_time_physics = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start_time).count();
-            this->total_calculations += calculations_per_frame;
+        for ( unsigned i = 0; i < due; ++i )
+        {
+            physics_step();
+            time_accumulator -= dt;
+            published_time += dt;
         }
+    }
+
+    if ( snapshots_enabled && snapshot_dirty )
+    {
+        publish_snapshot();
+        snapshot_dirty = false;
+    }
 
-        start_time = std::chrono::high_resolution_clock::now();
-        window->update();
+    if ( paused )
+        return PAUSED_WAIT;
+
+    // seconds until the next step is due
+    return time_rate > 0.0 ? std::max(0.0, (dt - time_accumulator) / time_rate) : 0.0;
+}
+
+void SimulationManager::post(Command command)
+{
+    std::lock_guard<std::mutex> lock(command_mutex);
+    pending_commands.push_back(command);
+}
 
-        elapsed_time_graphics = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start_time).count();
-        total_frame_time = elapsed_time_physics + elapsed_time_graphics;
+void SimulationManager::physics_step()
+{
+    this->calculations_per_frame = 0;
+
+    ++steps;
+
+    std::chrono::high_resolution_clock::time_point start_time = std::chrono::high_resolution_clock::now();
+    update_simulation();
 
-        // THIS IS SHIT, BUT IF I DONT DO IT LIKE THAT THE QUADTREE IS ALWAYS OFF BY ONE FRAME:)
-        if ( !paused ) bodies->update(dt);
+    elapsed_time_physics = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start_time).count();
+    this->total_calculations += calculations_per_frame;
+    simulated_time += dt;
+    update_average_ratios();
+
+    if ( checkpoint_interval > 0 && steps % checkpoint_interval == 0 )
+    {
+        save_checkpoint();
     }
+
+    if ( recorder.is_recording() && steps % record_interval == 0 )
+    {
+        record_frame();
+    }
+
+    if ( toggle_verbose ) print_thread_times();
+    snapshot_dirty = true;
 }
 
-/*
-tried multithreading, sadly this code is slower than the single threaded version
-it also had some issues with stats (var was not atomic), but too lazy to fix it
-void SimulationManager::run()
+const Snapshot& SimulationManager::latest_snapshot()
 {
-    std::chrono::high_resolution_clock::time_point start_time;
+    snapshots.update();
+    return snapshots.read_buffer();
+}
 
-    Vec2 top_left, bottom_right;
-    particle_manager->get_particle_area(top_left, bottom_right);
+void SimulationManager::run_commands()
+{
+    {
+        std::lock_guard<std::mutex> lock(command_mutex);
+        if ( pending_commands.empty() )
+            return;
 
-    std::atomic<bool> stopSimulation(false);
+        running_commands.swap(pending_commands);
+    }
 
-    // sim update thread
-    std::thread simulationThread([&]() {
-        while (!stopSimulation) {
-            calculations_per_frame = 0;
-            elapsed_time_physics = 0;
+    for ( Command command : running_commands )
+    {
+        (this->*command)();
+    }
 
-            if (!paused) {
-                ++steps;
+    running_commands.clear();
+    snapshot_dirty = true;
+}
+
+void SimulationManager::publish_snapshot()
+{
+    Snapshot& snapshot = snapshots.write_buffer();
+    const unsigned n = bodies->get_size();
+
+    // the positions of the last snapshot, interpolated from by the viewer when the steps run at a fixed rate
+    const bool interpolate = time_rate > 0.0 && !paused && published_positions.size() == n;
+    snapshot.previous_positions.clear();
+    if ( interpolate )
+    {
+        snapshot.previous_positions.assign(published_positions.begin(), published_positions.end());
+    }
+
+    // the very first snapshot has no range before it, its pass runs once more
+    if ( !shade_range_valid )
+    {
+        write_snapshot_bodies(snapshot);
+    }
+    write_snapshot_bodies(snapshot);
+
+    if ( time_rate > 0.0 )
+    {
+        published_positions.assign(snapshot.positions.begin(), snapshot.positions.end());
+    }
+    else
+    {
+        published_positions.clear();
+    }
+
+    snapshot.published_at = std::chrono::steady_clock::now();
+    snapshot.interval = published_time;
+    snapshot.time_rate = time_rate;
+    published_time = 0.0;
+
+    snapshot.bound_lines.clear();
+    if ( draw_quadtree )
+    {
+        const std::vector<Vec2T<float>>& lines = tree->get_bounding_lines();
+        snapshot.bound_lines.assign(lines.begin(), lines.end());
+    }
+
+    Vec2 top_left, bottom_right;
+    tree->get_size(top_left, bottom_right);
+    snapshot.center_of_mass = Vec2T<double>(tree->get_center_of_mass());
+    snapshot.top_left = Vec2T<double>(top_left);
+    snapshot.bottom_right = Vec2T<double>(bottom_right);
+
+    snapshot.paused = paused;
+    snapshot.draw_quadtree = draw_quadtree;
+    snapshot.draw_vectors = draw_vectors;
+    snapshot.debug = debug;
+    snapshot.load_balancing = tree->get_load_balancing();
+    snapshot.quadrupole = tree->get_quadrupole();
+    snapshot.refit = tree->get_refit();
+    snapshot.auto_tune_leaf_capacity = tree->get_auto_tune_leaf_capacity();
+    snapshot.collisions = collisions;
+
+    snapshot.G = G;
+    snapshot.theta = theta;
+    snapshot.dt = dt;
+    snapshot.fast_multipole = force_method == FAST_MULTIPOLE;
+    snapshot.multipole_order = fast_multipole->get_order();
+    snapshot.integrator = bodies->integrator;
+    snapshot.max_time_level = bodies->max_time_level;
+    snapshot.leaf_capacity = tree->get_leaf_capacity();
+    snapshot.num_threads = thread_pool->get_num_threads();
+
+    snapshot.step = steps;
+    snapshot.simulated_time = simulated_time;
+    snapshot.dropped_time = dropped_time;
+    snapshot.max_catch_up_steps = max_catch_up_steps;
+    snapshot.num_bodies = n;
+    snapshot.total_merges = total_merges;
+    snapshot.recording = recorder.is_recording();
+    snapshot.recorded_frames = recorder.get_recorded_frames();
+    snapshot.dropped_frames = recorder.get_dropped_frames();
+    snapshot.recorded_bytes = recorder.get_written_bytes();
+    snapshot.physics_time = get_elapsed_time_physics();
+    snapshot.tree_time = tree->get_build_time();
+    snapshot.last_was_refit = tree->get_last_was_refit();
+    snapshot.refit_count = tree->get_refit_count();
+    snapshot.rebuild_count = tree->get_rebuild_count();
+    snapshot.load_imbalance = get_load_imbalance();
+    snapshot.active_fraction = active_fraction;
+    snapshot.forces_per_body = forces_per_body;
+    snapshot.interactions_per_frame = get_interactions_per_frame();
+    snapshot.total_interactions = get_total_interactions();
+    snapshot.ratio_best_case = get_current_ratio_best_case();
+    snapshot.average_ratio_best_case = get_average_ratio_best_case();
+    snapshot.ratio_worst_case = get_current_ratio_worst_case();
+    snapshot.average_ratio_worst_case = get_average_ratio_worst_case();
+
+    snapshots.publish();
+}
+
+void SimulationManager::write_snapshot_bodies(Snapshot& snapshot)
+{
+    const unsigned n = bodies->get_size();
+    const double lowest = shade_lowest;
+    const double shade_scale = shade_highest > shade_lowest ? 255.0 / (shade_highest - shade_lowest) : 0.0;
 
-                start_time = std::chrono::high_resolution_clock::now();
-                update_simulation();
+    snapshot.positions.resize(n);
+    snapshot.shades.resize(n);
+    snapshot.velocities.resize(draw_vectors ? n : 0);
 
-                elapsed_time_physics = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start_time).count();
-                total_calculations += calculations_per_frame;
+    // positions, shades, velocities and the range of |a| in one pass, split between the threads
+    thread_shade_range.assign(thread_pool->get_num_threads(), std::make_pair(INFINITY, 0.0));
+    thread_pool->parallel_for(0, n, [&](unsigned start, unsigned end, unsigned thread_index)
+        {
+            double lowest_density = INFINITY, highest_density = 0.0;
+            for ( unsigned i = start; i < end; ++i )
+            {
+                const double density = std::sqrt(static_cast<double>(bodies->ax[i]) * bodies->ax[i] + static_cast<double>(bodies->ay[i]) * bodies->ay[i]);
+                lowest_density = std::min(lowest_density, density);
+                highest_density = std::max(highest_density, density);
+
+                snapshot.positions[i] = Vec2T<float>(bodies->x[i], bodies->y[i]);
+                snapshot.shades[i] = static_cast<uint8_t>(std::clamp((density - lowest) * shade_scale, 0.0, 255.0));
+            }
+
+            if ( draw_vectors )
+            {
+                for ( unsigned i = start; i < end; ++i )
+                {
+                    snapshot.velocities[i] = Vec2T<float>(bodies->vx[i], bodies->vy[i]);
+                }
             }
+
+            thread_shade_range[thread_index] = std::make_pair(lowest_density, highest_density);
+        });
+
+    shade_lowest = INFINITY;
+    shade_highest = 0.0;
+    for ( const std::pair<double, double>& range : thread_shade_range )
+    {
+        shade_lowest = std::min(shade_lowest, range.first);
+        shade_highest = std::max(shade_highest, range.second);
+    }
+    shade_range_valid = n > 0;
+}
+
+void SimulationManager::update_simulation()
+{
+    if ( !accelerations_valid )
+    {
+        bodies->substep = 0;
+        compute_forces(0.0);
+        accelerations_valid = true;
+    }
+
+    // a whole step: move the bodies, then the force pass finishes every body right after its force
+    if ( bodies->max_time_level == 0 )
+    {
+        update_bodies();
+        compute_forces(dt);
+
+        active_fraction = 1.0;
+        forces_per_body = 1.0;
+
+        if ( collisions ) merge_colliding_bodies();
+        return;
+    }
+
+    // block timesteps: the step is cut into substeps, only the bodies at the end of their own step get a force
+    const unsigned substeps = bodies->get_substeps();
+    const unsigned num_bodies = bodies->get_size();
+    const double substep_dt = dt / substeps;
+    unsigned long calculations = 0;
+    unsigned long started = 0;
+    unsigned events = 0;
+
+    thread_deepest_level.assign(thread_pool->get_num_threads(), 0);
+
+    for ( unsigned substep = 0; substep < substeps; )
+    {
+        bodies->substep = substep;
+
+        std::atomic<unsigned> starting(0);
+        thread_pool->parallel_for(0, num_bodies, [this, &starting](unsigned start, unsigned end, unsigned thread_index)
+            {
+                unsigned deepest_level;
+                starting += bodies->kick_starting_bodies(dt, start, end, deepest_level);
+                thread_deepest_level[thread_index] = std::max(thread_deepest_level[thread_index], deepest_level);
+            }, 16384);
+        started += starting;
+
+        // the deepest level in use decides when the next step ends, nothing happens in the substeps between
+        unsigned deepest_level = 0;
+        for ( unsigned& level : thread_deepest_level )
+        {
+            deepest_level = std::max(deepest_level, level);
+            level = 0;
+        }
+        const unsigned stride = 1u << (bodies->max_time_level - deepest_level);
+
+        thread_pool->parallel_for(0, num_bodies, [this, stride, substep_dt](unsigned start, unsigned end, unsigned)
+            {
+                bodies->drift(stride * substep_dt, start, end);
+            }, 16384);
+
+        substep += stride;
+        bodies->substep = substep & (substeps - 1);
+        compute_forces(dt);
+        calculations += calculations_per_frame;
+        ++events;
+    }
+
+    calculations_per_frame = calculations;
+    active_fraction = num_bodies > 0 ? static_cast<double>(started) / (static_cast<double>(num_bodies) * events) : 1.0;
+    forces_per_body = num_bodies > 0 ? static_cast<double>(started) / num_bodies : 1.0;
+
+    // only at the end of the whole step every body is at the same time
+    if ( collisions ) merge_colliding_bodies();
+}
+
+void SimulationManager::merge_colliding_bodies()
+{
+    // the broad phase runs in parallel on the tree of the last force pass, the bodies have not moved since
+    tree->find_collisions(collision_pairs);
+
+    // serial commit in the sorted order of the pairs, a body merges at most once per step so a chain of
+    // touching bodies takes a few steps. the heavier body survives (the lower index on a tie), the result
+    // does not depend on the number of threads
+    merged.assign(bodies->get_size(), 0);
+    unsigned merges = 0;
+
+    for ( const std::pair<uint32_t, uint32_t>& pair : collision_pairs )
+    {
+        if ( merged[pair.first] || merged[pair.second] )
+        {
+            continue;
         }
-    });
 
-    // window update in main thread
-    while (window->is_open()) {
-        start_time = std::chrono::high_resolution_clock::now();
-        window->update();
-        elapsed_time_graphics = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start_time).count();
-        total_frame_time = elapsed_time_physics + elapsed_time_graphics;
+        const bool keep_first = bodies->mass[pair.first] >= bodies->mass[pair.second];
+        bodies->merge_bodies(keep_first ? pair.first : pair.second, keep_first ? pair.second : pair.first);
+
+        merged[pair.first] = 1;
+        merged[pair.second] = 1;
+        ++merges;
     }
 
-    stopSimulation = true;
-    simulationThread.join();
+    if ( merges > 0 )
+    {
+        const std::vector<uint32_t>& remap = bodies->remove_merged_bodies();
+        tree->remap_bodies(remap);
+        total_merges += merges;
+
+        // the next snapshot interpolates from these, every body has to stay at its own index
+        if ( published_positions.size() == remap.size() )
+        {
+            unsigned kept = 0;
+            for ( uint32_t i = 0; i < remap.size(); ++i )
+            {
+                if ( remap[i] != Bodies::REMOVED )
+                {
+                    published_positions[remap[i]] = published_positions[i];
+                    ++kept;
+                }
+            }
+            published_positions.resize(kept);
+        }
+    }
+    last_merges = merges;
 }
-*/
 
-void SimulationManager::update_simulation()
+void SimulationManager::compute_forces(double dt)
 {
     Vec2 top_left, bottom_right;
     particle_manager->get_particle_area(top_left, bottom_right);
 
-    std::shared_ptr<sf::VertexArray> rectangles = std::make_shared<sf::VertexArray>(sf::Lines, 0);
-    tree = std::make_shared<QuadTree>(bodies, top_left, bottom_right, rectangles, true);
-    tree->update(theta, G, dt, calculations_per_frame);
+    // the tree keeps its node array between frames, rebuilding it does not allocate
+    tree->rebuild_or_refit(top_left, bottom_right);
+
+    // both fill bodies->acc, the fmm uses its own opening angle instead of theta
+    unsigned long calculations = 0;
+    if ( force_method == FAST_MULTIPOLE )
+    {
+        fast_multipole->update(G, dt, calculations);
+    }
+    else
+    {
+        tree->update(theta, G, dt, calculations);
+    }
+    calculations_per_frame = calculations;
+}
+
+void SimulationManager::set_force_method(enum ForceMethod force_method)
+{
+    if ( force_method == this->force_method )
+    {
+        return;
+    }
+
+    const unsigned leaf_capacity = tree->get_leaf_capacity();
+    tree->set_leaf_capacity(inactive_leaf_capacity);
+    inactive_leaf_capacity = leaf_capacity;
+
+    this->force_method = force_method;
+}
+
+void SimulationManager::update_bodies()
+{
+    thread_pool->parallel_for(0, bodies->get_size(), [this](unsigned start, unsigned end, unsigned)
+        {
+            bodies->begin_step(dt, start, end);
+        }, 16384);
 }
 
 void SimulationManager::reset_simulation()
@@ -131,52 +517,138 @@ void SimulationManager::reset_simulation()
     calc_best_case = 0;
     calc_worst_case = 0;
     elapsed_time_physics = 0;
-    elapsed_time_graphics = 0;
-    total_frame_time = 0;
 
     particle_manager->reset();
+    accelerations_valid = false;
+    simulated_time = 0.0;
+    dropped_time = 0.0;
+    published_positions.clear();
+    last_merges = 0;
+    total_merges = 0;
 }
 
-double SimulationManager::get_current_ratio_worst_case()
+void SimulationManager::save_checkpoint()
 {
-    if ( calc_best_case == 0 || calc_worst_case == 0 )
+    CheckpointState state;
+    state.G = G;
+    state.theta = theta;
+    state.dt = dt;
+    state.steps = steps;
+    state.simulated_time = simulated_time;
+    state.rng_state = particle_manager->get_rng_state();
+
+    if ( !checkpoint_writer.write(checkpoint_path, *bodies, state) )
     {
-        calc_best_case = bodies->get_size() * bodies->get_size();
-        calc_worst_case = bodies->get_size() * log2(bodies->get_size());
+        std::cerr << "skipped the checkpoint at step " << steps << ", the previous one is still being written" << std::endl;
     }
+}
 
-    return calc_worst_case / static_cast<double>(this->calculations_per_frame);
+void SimulationManager::toggle_recording()
+{
+    if ( recorder.is_recording() )
+    {
+        recorder.stop();
+        std::cout << "recorded " << recorder.get_recorded_frames() << " frames (" << recorder.get_dropped_frames() << " dropped), "
+            << recorder.get_written_bytes() / 1e6 << " MB to " << record_path << std::endl;
+    }
+    else if ( recorder.start(record_path, G, dt, record_interval) )
+    {
+        record_frame();
+    }
+    snapshot_dirty = true;
 }
 
-double SimulationManager::get_current_ratio_best_case()
+void SimulationManager::record_frame()
 {
-    if ( calc_best_case == 0 || calc_worst_case == 0 )
+    Vec2 top_left, bottom_right;
+    particle_manager->get_particle_area(top_left, bottom_right);
+
+    recorder.record(*bodies, steps, simulated_time, top_left, bottom_right);
+}
+
+bool SimulationManager::load_checkpoint(const std::string& path)
+{
+    CheckpointState state;
+    if ( !read_checkpoint(path, *bodies, state) )
     {
-        calc_best_case = bodies->get_size() * bodies->get_size();
-        calc_worst_case = bodies->get_size() * log2(bodies->get_size());
+        return false;
     }
 
-    return calc_best_case / static_cast<double>(this->calculations_per_frame);
+    G = state.G;
+    theta = state.theta;
+    dt = state.dt;
+    steps = state.steps;
+    simulated_time = state.simulated_time;
+    particle_manager->set_rng_state(state.rng_state);
+
+    // the accelerations were stored at the end of a whole step, the next step can use them as they are
+    accelerations_valid = true;
+    total_calculations = 0;
+    published_positions.clear();
+    snapshot_dirty = true;
+
+    return true;
 }
 
-double SimulationManager::get_average_ratio_best_case()
+double SimulationManager::get_load_imbalance() const
 {
-    if ( paused )
+    // slowest thread compared to the average one, 1.0 means every thread finished at the same time
+    const std::vector<double>& busy_time = tree->get_thread_busy_time();
+
+    double max_busy = 0.0;
+    double total_busy = 0.0;
+    unsigned active_threads = 0;
+
+    for ( double busy : busy_time )
     {
-        return average_ratio_best_case;
+        if ( busy > 0.0 )
+        {
+            max_busy = std::max(max_busy, busy);
+            total_busy += busy;
+            ++active_threads;
+        }
     }
 
-    average_ratio_best_case = (average_ratio_best_case * (steps - 1) + get_current_ratio_best_case()) / steps;
-    return average_ratio_best_case;
+    return total_busy > 0.0 ? max_busy * active_threads / total_busy : 1.0;
 }
 
-double SimulationManager::get_average_ratio_worst_case()
+void SimulationManager::print_thread_times() const
 {
-    if ( paused )
+    const std::vector<double>& busy_time = tree->get_thread_busy_time();
+    const std::vector<double>& idle_time = tree->get_thread_idle_time();
+
+    std::cout << "step " << steps << (tree->get_load_balancing() ? " (balanced)" : " (static)") << std::fixed << std::setprecision(2) << std::endl;
+    for ( unsigned t = 0; t < busy_time.size(); ++t )
     {
-        return average_ratio_worst_case;
+        std::cout << " - thread " << t << ": busy " << busy_time[t] << " ms, idle " << idle_time[t] << " ms" << std::endl;
     }
+    std::cout << " - imbalance: " << get_load_imbalance() << "x" << std::endl;
+}
 
+double SimulationManager::get_current_ratio_worst_case()
+{
+    if ( calc_best_case == 0 || calc_worst_case == 0 )
+    {
+        calc_best_case = static_cast<double>(bodies->get_size()) * bodies->get_size();
+        calc_worst_case = bodies->get_size() * log2(bodies->get_size());
+    }
+
+    return calc_worst_case / static_cast<double>(this->calculations_per_frame);
+}
+
+double SimulationManager::get_current_ratio_best_case()
+{
+    if ( calc_best_case == 0 || calc_worst_case == 0 )
+    {
+        calc_best_case = static_cast<double>(bodies->get_size()) * bodies->get_size();
+        calc_worst_case = bodies->get_size() * log2(bodies->get_size());
+    }
+
+    return calc_best_case / static_cast<double>(this->calculations_per_frame);
+}
+
+void SimulationManager::update_average_ratios()
+{
+    average_ratio_best_case = (average_ratio_best_case * (steps - 1) + get_current_ratio_best_case()) / steps;
     average_ratio_worst_case = (average_ratio_worst_case * (steps - 1) + get_current_ratio_worst_case()) / steps;
-    return average_ratio_worst_case;
 }
@@ -0,0 +1,121 @@
+#include "ThreadPool.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/*----------------------------------------
+|         Constructor/Destructor         |
+-----------------------------------------*/
+
+ThreadPool::ThreadPool(unsigned num_threads, bool pin_threads)
+    : generation(0), remaining(0), stopping(false), job(nullptr), job_context(nullptr)
+{
+    if ( num_threads == 0 )
+    {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    this->num_threads = num_threads;
+
+    workers.reserve(num_threads - 1);
+    for ( unsigned t = 1; t < num_threads; ++t )
+    {
+        workers.emplace_back(&ThreadPool::worker_loop, this, t);
+
+        if ( pin_threads )
+        {
+            pin_to_core(workers.back().native_handle(), t);
+        }
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    start_condition.notify_all();
+
+    for ( std::thread& worker : workers )
+    {
+        worker.join();
+    }
+}
+
+
+/*----------------------------------------
+|            private methods             |
+-----------------------------------------*/
+
+void ThreadPool::dispatch(void (*function)(void*, unsigned), void* context)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = function;
+        job_context = context;
+        remaining = num_threads - 1;
+        ++generation;
+    }
+    start_condition.notify_all();
+
+    // the caller is thread 0
+    function(context, 0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done_condition.wait(lock, [this]() { return remaining == 0; });
+}
+
+void ThreadPool::worker_loop(unsigned thread_index)
+{
+    uint64_t seen_generation = 0;
+
+    while ( true )
+    {
+        void (*function)(void*, unsigned);
+        void* context;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            start_condition.wait(lock, [this, seen_generation]() { return stopping || generation != seen_generation; });
+
+            if ( stopping )
+            {
+                return;
+            }
+
+            seen_generation = generation;
+            function = job;
+            context = job_context;
+        }
+
+        function(context, thread_index);
+
+        bool last;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            last = --remaining == 0;
+        }
+
+        if ( last )
+        {
+            done_condition.notify_one();
+        }
+    }
+}
+
+void ThreadPool::pin_to_core(std::thread::native_handle_type handle, unsigned core)
+{
+#ifdef __linux__
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(core % std::max(1u, std::thread::hardware_concurrency()), &cpu_set);
+    pthread_setaffinity_np(handle, sizeof(cpu_set_t), &cpu_set);
+#else
+    // macos has no hard affinity, the scheduler does a decent job on its own
+    (void)handle;
+    (void)core;
+#endif
+}
@@ -0,0 +1,764 @@
+#include "Trajectory.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+void TrajectoryFrame::resize(unsigned n)
+{
+    for ( std::vector<real>* component : { &x, &y, &vx, &vy, &mass, &radius } )
+    {
+        component->resize(n);
+    }
+}
+
+
+/*----------------------------------------
+|               lz codec                 |
+-----------------------------------------*/
+
+static inline uint32_t read32(const uint8_t* p)
+{
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint64_t read64(const uint8_t* p)
+{
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// lengths that do not fit into the 4 bits of the token continue in bytes of 255, the last one is smaller
+static inline void write_length(uint8_t*& out, std::size_t length)
+{
+    while ( length >= 255 )
+    {
+        *out++ = 255;
+        length -= 255;
+    }
+    *out++ = static_cast<uint8_t>(length);
+}
+
+static inline bool read_length(const uint8_t*& in, const uint8_t* in_end, std::size_t& length)
+{
+    uint8_t byte;
+    do
+    {
+        if ( in == in_end )
+            return false;
+
+        byte = *in++;
+        length += byte;
+    } while ( byte == 255 );
+
+    return true;
+}
+
+void LzCodec::compress(const uint8_t* in, std::size_t size, std::vector<uint8_t>& out)
+{
+    // only literals is the worst case, one token and a few length bytes more than the input
+    out.resize(size + size / 255 + 16);
+    hash_table.assign(1u << HASH_BITS, 0);
+
+    uint8_t* op = out.data();
+    std::size_t anchor = 0;
+    std::size_t i = 0;
+
+    // the last bytes are always literals, so matches never read past the end
+    const std::size_t match_limit = size > 12 ? size - 12 : 0;
+    const std::size_t match_end = size > 5 ? size - 5 : 0;
+
+    while ( i < match_limit )
+    {
+        const uint32_t sequence = read32(in + i);
+        const uint32_t hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+        const std::size_t candidate = hash_table[hash];     // position + 1, 0 is empty
+        hash_table[hash] = static_cast<uint32_t>(i + 1);
+
+        if ( candidate == 0 || i + 1 - candidate > MAX_OFFSET || read32(in + candidate - 1) != sequence )
+        {
+            // the longer nothing matched, the faster it skips ahead (incompressible data stays cheap)
+            i += 1 + ((i - anchor) >> 6);
+            continue;
+        }
+
+        const std::size_t match = candidate - 1;
+        std::size_t length = MIN_MATCH;
+        while ( i + length + 8 <= match_end )
+        {
+            const uint64_t difference = read64(in + match + length) ^ read64(in + i + length);
+            if ( difference != 0 )
+            {
+                length += __builtin_ctzll(difference) >> 3;
+                break;
+            }
+            length += 8;
+        }
+        if ( i + length + 8 > match_end )
+        {
+            while ( i + length < match_end && in[match + length] == in[i + length] )
+            {
+                ++length;
+            }
+        }
+
+        const std::size_t literals = i - anchor;
+        uint8_t* token = op++;
+        *token = static_cast<uint8_t>((std::min<std::size_t>(literals, 15) << 4) | std::min<std::size_t>(length - MIN_MATCH, 15));
+        if ( literals >= 15 )
+        {
+            write_length(op, literals - 15);
+        }
+
+        std::memcpy(op, in + anchor, literals);
+        op += literals;
+
+        const std::size_t offset = i - match;
+        *op++ = static_cast<uint8_t>(offset & 0xff);
+        *op++ = static_cast<uint8_t>(offset >> 8);
+
+        if ( length - MIN_MATCH >= 15 )
+        {
+            write_length(op, length - MIN_MATCH - 15);
+        }
+
+        i += length;
+        anchor = i;
+    }
+
+    // the final sequence only has literals
+    const std::size_t literals = size - anchor;
+    *op++ = static_cast<uint8_t>(std::min<std::size_t>(literals, 15) << 4);
+    if ( literals >= 15 )
+    {
+        write_length(op, literals - 15);
+    }
+    std::memcpy(op, in + anchor, literals);
+    op += literals;
+
+    out.resize(op - out.data());
+}
+
+bool LzCodec::decompress(const uint8_t* in, std::size_t size, uint8_t* out, std::size_t out_size)
+{
+    const uint8_t* ip = in;
+    const uint8_t* const in_end = in + size;
+    uint8_t* op = out;
+    uint8_t* const out_end = out + out_size;
+
+    while ( ip < in_end )
+    {
+        const uint8_t token = *ip++;
+
+        std::size_t literals = token >> 4;
+        if ( literals == 15 && !read_length(ip, in_end, literals) )
+            return false;
+
+        if ( literals > static_cast<std::size_t>(in_end - ip) || literals > static_cast<std::size_t>(out_end - op) )
+            return false;
+
+        std::memcpy(op, ip, literals);
+        op += literals;
+        ip += literals;
+
+        if ( ip == in_end )
+            break;
+
+        if ( in_end - ip < 2 )
+            return false;
+
+        const std::size_t offset = ip[0] | (static_cast<std::size_t>(ip[1]) << 8);
+        ip += 2;
+        if ( offset == 0 || offset > static_cast<std::size_t>(op - out) )
+            return false;
+
+        std::size_t length = (token & 15) + MIN_MATCH;
+        if ( (token & 15) == 15 && !read_length(ip, in_end, length) )
+            return false;
+
+        if ( length > static_cast<std::size_t>(out_end - op) )
+            return false;
+
+        // overlapping matches repeat the last offset bytes, they have to be copied front to back
+        const uint8_t* match = op - offset;
+        if ( offset >= length )
+        {
+            std::memcpy(op, match, length);
+        }
+        else
+        {
+            for ( std::size_t k = 0; k < length; ++k )
+            {
+                op[k] = match[k];
+            }
+        }
+        op += length;
+    }
+
+    return op == out_end;
+}
+
+
+/*----------------------------------------
+|            frame encoding              |
+-----------------------------------------*/
+
+static inline uint8_t* write_varint(uint8_t* out, uint32_t value)
+{
+    while ( value >= 0x80 )
+    {
+        *out++ = static_cast<uint8_t>(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = static_cast<uint8_t>(value);
+    return out;
+}
+
+static inline bool read_varint(const uint8_t*& in, const uint8_t* in_end, uint32_t& value)
+{
+    value = 0;
+    for ( unsigned shift = 0; shift < 35; shift += 7 )
+    {
+        if ( in == in_end )
+            return false;
+
+        const uint8_t byte = *in++;
+        value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        if ( byte < 0x80 )
+            return true;
+    }
+    return false;
+}
+
+// small differences of either sign become small unsigned numbers: 0, -1, 1, -2, ... -> 0, 1, 2, 3, ...
+static inline uint32_t zigzag(uint32_t difference)
+{
+    const int32_t value = static_cast<int32_t>(difference);
+    return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+
+static inline uint32_t unzigzag(uint32_t value)
+{
+    return (value >> 1) ^ (0u - (value & 1));
+}
+
+void TrajectoryCodec::set_bits(unsigned position_bits, unsigned velocity_bits)
+{
+    this->position_bits = std::clamp(position_bits, MIN_BITS, MAX_BITS);
+    this->velocity_bits = std::clamp(velocity_bits, MIN_BITS, MAX_BITS);
+}
+
+// the range of the quantized component c (x, y, vx, vy) of a frame, value = offset + q / scale
+static void component_range(const TrajectoryFrameHeader& header, unsigned c, unsigned bits, double& offset, double& scale)
+{
+    const double levels = static_cast<double>((1u << bits) - 1);
+
+    double extent;
+    if ( c < 2 )
+    {
+        offset = c == 0 ? header.min_x : header.min_y;
+        extent = c == 0 ? header.max_x - header.min_x : header.max_y - header.min_y;
+    }
+    else
+    {
+        offset = -header.max_velocity;
+        extent = 2.0 * header.max_velocity;
+    }
+
+    scale = extent > 0.0 ? levels / extent : 0.0;
+}
+
+void TrajectoryCodec::encode(const TrajectoryFrame& frame, bool keyframe, TrajectoryFrameHeader& header, std::vector<uint8_t>& out)
+{
+    const unsigned n = frame.size();
+    keyframe = keyframe || previous[0].size() != n;
+
+    real max_velocity = 0;
+    for ( unsigned i = 0; i < n; ++i )
+    {
+        max_velocity = std::max(max_velocity, std::max(std::abs(frame.vx[i]), std::abs(frame.vy[i])));
+    }
+
+    header.flags = keyframe ? TrajectoryFrameHeader::KEYFRAME : 0;
+    header.step = frame.step;
+    header.simulated_time = frame.simulated_time;
+    header.num_bodies = n;
+    header.min_x = frame.top_left.x;
+    header.min_y = frame.top_left.y;
+    header.max_x = frame.bottom_right.x;
+    header.max_y = frame.bottom_right.y;
+    header.max_velocity = max_velocity;
+
+    // 5 bytes are the longest varint of 32 bits
+    raw.resize(4 * 5 * static_cast<std::size_t>(n) + (keyframe ? 2 * sizeof(float) * static_cast<std::size_t>(n) : 0));
+    uint8_t* write = raw.data();
+
+    const std::vector<real>* components[4] = { &frame.x, &frame.y, &frame.vx, &frame.vy };
+    for ( unsigned c = 0; c < 4; ++c )
+    {
+        const unsigned bits = c < 2 ? position_bits : velocity_bits;
+        const double levels = static_cast<double>((1u << bits) - 1);
+
+        double offset, scale;
+        component_range(header, c, bits, offset, scale);
+
+        const real* values = components[c]->data();
+        previous[c].resize(n);
+        uint32_t* last = previous[c].data();
+
+        for ( unsigned i = 0; i < n; ++i )
+        {
+            const double level = std::clamp(std::nearbyint((values[i] - offset) * scale), 0.0, levels);
+            const uint32_t quantized = static_cast<uint32_t>(level);
+
+            write = write_varint(write, zigzag(keyframe ? quantized : quantized - last[i]));
+            last[i] = quantized;
+        }
+    }
+
+    // the masses and radii only change with merges, which change the number of bodies and force a keyframe
+    if ( keyframe )
+    {
+        for ( const std::vector<real>* component : { &frame.mass, &frame.radius } )
+        {
+            for ( unsigned i = 0; i < n; ++i )
+            {
+                const float value = static_cast<float>((*component)[i]);
+                std::memcpy(write, &value, sizeof(value));
+                write += sizeof(value);
+            }
+        }
+    }
+
+    header.raw_size = static_cast<uint32_t>(write - raw.data());
+
+    lz.compress(raw.data(), header.raw_size, out);
+    if ( out.size() >= header.raw_size )
+    {
+        out.assign(raw.data(), write);
+        header.flags |= TrajectoryFrameHeader::STORED;
+    }
+    header.compressed_size = out.size();
+}
+
+bool TrajectoryCodec::decode(const TrajectoryFrameHeader& header, const uint8_t* payload, TrajectoryFrame* frame)
+{
+    const unsigned n = header.num_bodies;
+    const bool keyframe = header.flags & TrajectoryFrameHeader::KEYFRAME;
+    if ( !keyframe && previous[0].size() != n )
+        return false;
+
+    const uint8_t* read = payload;
+    if ( header.flags & TrajectoryFrameHeader::STORED )
+    {
+        if ( header.compressed_size != header.raw_size )
+            return false;
+    }
+    else
+    {
+        raw.resize(header.raw_size);
+        if ( !LzCodec::decompress(payload, header.compressed_size, raw.data(), raw.size()) )
+            return false;
+
+        read = raw.data();
+    }
+    const uint8_t* const read_end = read + header.raw_size;
+
+    if ( frame != nullptr )
+    {
+        frame->step = header.step;
+        frame->simulated_time = header.simulated_time;
+        frame->top_left = Vec2T<double>(header.min_x, header.min_y);
+        frame->bottom_right = Vec2T<double>(header.max_x, header.max_y);
+        frame->resize(n);
+    }
+
+    for ( unsigned c = 0; c < 4; ++c )
+    {
+        previous[c].resize(n);
+        uint32_t* last = previous[c].data();
+
+        // frames that are only passed on the way to another one just update the quantized values
+        if ( frame == nullptr )
+        {
+            for ( unsigned i = 0; i < n; ++i )
+            {
+                uint32_t value;
+                if ( !read_varint(read, read_end, value) )
+                    return false;
+
+                last[i] = (keyframe ? 0 : last[i]) + unzigzag(value);
+            }
+            continue;
+        }
+
+        double offset, scale;
+        component_range(header, c, c < 2 ? position_bits : velocity_bits, offset, scale);
+        const double step = scale > 0.0 ? 1.0 / scale : 0.0;
+
+        std::vector<real>* components[4] = { &frame->x, &frame->y, &frame->vx, &frame->vy };
+        real* values = components[c]->data();
+
+        for ( unsigned i = 0; i < n; ++i )
+        {
+            uint32_t value;
+            if ( !read_varint(read, read_end, value) )
+                return false;
+
+            const uint32_t quantized = (keyframe ? 0 : last[i]) + unzigzag(value);
+            last[i] = quantized;
+            values[i] = static_cast<real>(offset + quantized * step);
+        }
+    }
+
+    if ( keyframe )
+    {
+        if ( static_cast<std::size_t>(read_end - read) != 2 * sizeof(float) * static_cast<std::size_t>(n) )
+            return false;
+
+        for ( std::vector<real>* component : { &mass, &radius } )
+        {
+            component->resize(n);
+            for ( unsigned i = 0; i < n; ++i )
+            {
+                float value;
+                std::memcpy(&value, read, sizeof(value));
+                read += sizeof(value);
+                (*component)[i] = value;
+            }
+        }
+    }
+    else if ( read != read_end )
+    {
+        return false;
+    }
+
+    if ( frame != nullptr )
+    {
+        std::copy(mass.begin(), mass.end(), frame->mass.begin());
+        std::copy(radius.begin(), radius.end(), frame->radius.begin());
+    }
+
+    return true;
+}
+
+
+/*----------------------------------------
+|               recording                |
+-----------------------------------------*/
+
+TrajectoryRecorder::~TrajectoryRecorder()
+{
+    stop();
+}
+
+bool TrajectoryRecorder::start(const std::string& path, double G, double dt, unsigned record_interval)
+{
+    stop();
+
+    file = std::fopen(path.c_str(), "wb");
+    if ( file == nullptr )
+    {
+        std::cerr << "Error: could not create trajectory " << path << std::endl;
+        return false;
+    }
+
+    position_bits = std::clamp(position_bits, TrajectoryCodec::MIN_BITS, TrajectoryCodec::MAX_BITS);
+    velocity_bits = std::clamp(velocity_bits, TrajectoryCodec::MIN_BITS, TrajectoryCodec::MAX_BITS);
+    codec.set_bits(position_bits, velocity_bits);
+
+    TrajectoryHeader header {};
+    std::memcpy(header.magic, TrajectoryHeader::MAGIC, sizeof(header.magic));
+    header.version = TrajectoryHeader::VERSION;
+    header.position_bits = position_bits;
+    header.velocity_bits = velocity_bits;
+    header.keyframe_interval = keyframe_interval;
+    header.record_interval = record_interval;
+    header.G = G;
+    header.dt = dt;
+
+    if ( std::fwrite(&header, sizeof(header), 1, file) != 1 )
+    {
+        std::cerr << "Error: could not write trajectory " << path << std::endl;
+        std::fclose(file);
+        file = nullptr;
+        return false;
+    }
+
+    ring.resize(RING_SIZE);
+    head = 0;
+    tail = 0;
+    recorded_frames = 0;
+    dropped_frames = 0;
+    written_bytes = sizeof(header);
+    raw_bytes = 0;
+
+    running = true;
+    thread = std::thread(&TrajectoryRecorder::write_frames, this);
+
+    return true;
+}
+
+void TrajectoryRecorder::stop()
+{
+    if ( !thread.joinable() )
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex);
+        running = false;
+    }
+    wake.notify_one();
+    thread.join();
+
+    std::fclose(file);
+    file = nullptr;
+}
+
+bool TrajectoryRecorder::record(const Bodies& bodies, long step, double simulated_time, Vec2 top_left, Vec2 bottom_right)
+{
+    if ( !running )
+        return false;
+
+    const uint64_t h = head.load(std::memory_order_relaxed);
+    if ( h - tail.load(std::memory_order_acquire) >= ring.size() )
+    {
+        ++dropped_frames;
+        return false;
+    }
+
+    TrajectoryFrame& frame = ring[h % ring.size()];
+    const unsigned n = bodies.size;
+
+    frame.resize(n);
+    frame.step = step;
+    frame.simulated_time = simulated_time;
+    frame.top_left = Vec2T<double>(top_left);
+    frame.bottom_right = Vec2T<double>(bottom_right);
+
+    std::copy(bodies.x.data(), bodies.x.data() + n, frame.x.data());
+    std::copy(bodies.y.data(), bodies.y.data() + n, frame.y.data());
+    std::copy(bodies.vx.data(), bodies.vx.data() + n, frame.vx.data());
+    std::copy(bodies.vy.data(), bodies.vy.data() + n, frame.vy.data());
+    std::copy(bodies.mass.data(), bodies.mass.data() + n, frame.mass.data());
+    std::copy(bodies.radius.data(), bodies.radius.data() + n, frame.radius.data());
+
+    head.store(h + 1, std::memory_order_release);
+    wake.notify_one();
+
+    return true;
+}
+
+void TrajectoryRecorder::write_frames()
+{
+    std::chrono::steady_clock::time_point next_write = std::chrono::steady_clock::now();
+    unsigned frames_since_keyframe = keyframe_interval;
+    bool failed = false;
+
+    while ( true )
+    {
+        const uint64_t t = tail.load(std::memory_order_relaxed);
+        if ( t == head.load(std::memory_order_acquire) )
+        {
+            // stop() only ends the thread once everything recorded so far is written
+            std::unique_lock<std::mutex> lock(wake_mutex);
+            if ( !running )
+                break;
+
+            // record() notifies without the lock, a missed wake up only costs the timeout
+            wake.wait_for(lock, std::chrono::milliseconds(5));
+            continue;
+        }
+
+        const TrajectoryFrame& frame = ring[t % ring.size()];
+
+        TrajectoryFrameHeader header {};
+        header.magic = TrajectoryFrameHeader::MAGIC;
+        codec.encode(frame, frames_since_keyframe >= keyframe_interval, header, payload);
+        frames_since_keyframe = (header.flags & TrajectoryFrameHeader::KEYFRAME) ? 1 : frames_since_keyframe + 1;
+        raw_bytes += 4 * sizeof(real) * static_cast<unsigned long>(frame.size());
+
+        // the payload is our own, the slot can be refilled while this frame waits for the bandwidth
+        tail.store(t + 1, std::memory_order_release);
+
+        const std::size_t frame_bytes = sizeof(header) + payload.size();
+        const double limit = bandwidth;
+        if ( limit > 0.0 )
+        {
+            // no credit is saved up while idle, the limit holds for bursts too
+            const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            if ( next_write > now )
+            {
+                std::this_thread::sleep_until(next_write);
+            }
+            else
+            {
+                next_write = now;
+            }
+            next_write += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(frame_bytes / limit));
+        }
+
+        if ( !failed )
+        {
+            failed = std::fwrite(&header, sizeof(header), 1, file) != 1
+                || std::fwrite(payload.data(), 1, payload.size(), file) != payload.size();
+
+            if ( failed )
+            {
+                std::cerr << "Error: could not write trajectory frame, recording the rest is skipped" << std::endl;
+            }
+        }
+
+        if ( !failed )
+        {
+            written_bytes += frame_bytes;
+            ++recorded_frames;
+        }
+    }
+}
+
+
+/*----------------------------------------
+|               playback                 |
+-----------------------------------------*/
+
+TrajectoryReader::~TrajectoryReader()
+{
+    close();
+}
+
+void TrajectoryReader::close()
+{
+    if ( data != nullptr )
+    {
+        munmap(const_cast<uint8_t*>(data), file_size);
+    }
+
+    data = nullptr;
+    file_size = 0;
+    frames.clear();
+    decoded = -1;
+}
+
+bool TrajectoryReader::open(const std::string& path)
+{
+    close();
+
+    const int descriptor = ::open(path.c_str(), O_RDONLY);
+    if ( descriptor < 0 )
+        return false;
+
+    struct stat file_stat;
+    if ( fstat(descriptor, &file_stat) != 0 || static_cast<uint64_t>(file_stat.st_size) < sizeof(TrajectoryHeader) )
+    {
+        ::close(descriptor);
+        return false;
+    }
+
+    file_size = file_stat.st_size;
+    void* mapping = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    ::close(descriptor);
+
+    if ( mapping == MAP_FAILED )
+    {
+        file_size = 0;
+        return false;
+    }
+    data = static_cast<const uint8_t*>(mapping);
+
+    std::memcpy(&header, data, sizeof(header));
+    if ( std::memcmp(header.magic, TrajectoryHeader::MAGIC, sizeof(header.magic)) != 0 || header.version != TrajectoryHeader::VERSION )
+    {
+        close();
+        return false;
+    }
+    codec.set_bits(header.position_bits, header.velocity_bits);
+
+    // hops from frame header to frame header, only the pages of the headers are touched
+    uint64_t offset = sizeof(TrajectoryHeader);
+    uint32_t keyframe = 0;
+    while ( file_size - offset >= sizeof(TrajectoryFrameHeader) )
+    {
+        TrajectoryFrameHeader frame_header;
+        std::memcpy(&frame_header, data + offset, sizeof(frame_header));
+
+        if ( frame_header.magic != TrajectoryFrameHeader::MAGIC
+            || frame_header.compressed_size > file_size - offset - sizeof(TrajectoryFrameHeader) )
+            break;
+
+        if ( frame_header.flags & TrajectoryFrameHeader::KEYFRAME )
+        {
+            keyframe = frames.size();
+        }
+        else if ( frames.empty() )
+        {
+            break;
+        }
+
+        frames.push_back({ offset, frame_header.step, frame_header.simulated_time, keyframe });
+        offset += sizeof(TrajectoryFrameHeader) + frame_header.compressed_size;
+    }
+
+    prefetch(0);
+    return true;
+}
+
+void TrajectoryReader::prefetch(std::size_t index) const
+{
+    if ( index >= frames.size() )
+        return;
+
+    const std::size_t last = std::min(index + PREFETCH_FRAMES, frames.size());
+    const uint64_t end = last < frames.size() ? frames[last].offset : file_size;
+
+    // madvise wants a page aligned start
+    const uint64_t page_size = sysconf(_SC_PAGESIZE);
+    const uint64_t begin = frames[index].offset / page_size * page_size;
+    madvise(const_cast<uint8_t*>(data) + begin, end - begin, MADV_WILLNEED);
+}
+
+bool TrajectoryReader::read(std::size_t index, TrajectoryFrame& frame)
+{
+    if ( index >= frames.size() )
+        return false;
+
+    // continue from the last decoded frame if it lies between the keyframe and the frame, otherwise restart at the keyframe
+    const std::size_t keyframe = frames[index].keyframe;
+    std::size_t first = keyframe;
+    if ( decoded >= static_cast<long>(keyframe) && decoded < static_cast<long>(index) )
+    {
+        first = decoded + 1;
+    }
+
+    prefetch(index + 1);
+
+    for ( std::size_t i = first; i <= index; ++i )
+    {
+        TrajectoryFrameHeader frame_header;
+        std::memcpy(&frame_header, data + frames[i].offset, sizeof(frame_header));
+
+        if ( !codec.decode(frame_header, data + frames[i].offset + sizeof(frame_header), i == index ? &frame : nullptr) )
+        {
+            decoded = -1;
+            return false;
+        }
+        decoded = i;
+    }
+
+    return true;
+}
+
+std::size_t TrajectoryReader::find_frame(double simulated_time) const
+{
+    const auto after = std::upper_bound(frames.begin(), frames.end(), simulated_time,
+        [](double time, const FrameEntry& entry) { return time < entry.simulated_time; });
+
+    return after == frames.begin() ? 0 : (after - frames.begin()) - 1;
+}
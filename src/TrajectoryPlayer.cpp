@@ -0,0 +1,264 @@
+#include "TrajectoryPlayer.h"
+
+#include <cmath>
+#include <iostream>
+
+/*----------------------------------------
+|             public methods             |
+-----------------------------------------*/
+
+bool TrajectoryPlayer::open(const std::string& path)
+{
+    if ( !reader.open(path) || reader.get_frame_count() == 0 )
+    {
+        std::cerr << "Error: could not read trajectory " << path << std::endl;
+        return false;
+    }
+
+    // one recorded frame per frame of a 60 Hz display to begin with
+    const TrajectoryHeader& header = reader.get_header();
+    time_rate = 60.0 * header.dt * std::max(1u, header.record_interval);
+
+    load_frame(0);
+    play_time = reader.get_simulated_time(0);
+    last_advance = std::chrono::steady_clock::now();
+
+    return loaded;
+}
+
+double TrajectoryPlayer::advance()
+{
+    run_commands();
+
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    const double elapsed = std::chrono::duration<double>(now - last_advance).count();
+    last_advance = now;
+
+    const std::size_t count = reader.get_frame_count();
+
+    const double seek_to = requested_seek.exchange(-1.0);
+    if ( seek_to >= 0.0 )
+    {
+        const std::size_t index = static_cast<std::size_t>(std::lround(seek_to * (count - 1)));
+        load_frame(seek_keyframe ? reader.get_keyframe(index) : index);
+        play_time = reader.get_simulated_time(current);
+        continuous = false;
+    }
+    else if ( !paused )
+    {
+        // only the frame that is due is shown, the ones in between are decoded but never published
+        play_time += elapsed * time_rate;
+        const std::size_t due = reader.find_frame(play_time);
+        if ( due > current )
+        {
+            load_frame(due);
+        }
+    }
+
+    // playing or seeking onto the last frame stops there, there is no frame after it to wait for
+    if ( !paused && current + 1 >= count )
+    {
+        paused = true;
+        snapshot_dirty = true;
+    }
+
+    if ( snapshot_dirty )
+    {
+        publish_snapshot();
+        snapshot_dirty = false;
+    }
+
+    if ( paused || time_rate <= 0.0 )
+        return PAUSED_WAIT;
+
+    // seconds until the next frame is due
+    return std::max(0.0, (reader.get_simulated_time(current + 1) - play_time) / time_rate);
+}
+
+void TrajectoryPlayer::post(Command command)
+{
+    std::lock_guard<std::mutex> lock(command_mutex);
+    pending_commands.push_back(command);
+}
+
+const Snapshot& TrajectoryPlayer::latest_snapshot()
+{
+    snapshots.update();
+    return snapshots.read_buffer();
+}
+
+void TrajectoryPlayer::step_forward()
+{
+    paused = true;
+    load_frame(std::min(current + 1, reader.get_frame_count() - 1));
+    play_time = reader.get_simulated_time(current);
+    continuous = false;
+}
+
+void TrajectoryPlayer::step_backward()
+{
+    paused = true;
+    load_frame(current > 0 ? current - 1 : 0);
+    play_time = reader.get_simulated_time(current);
+    continuous = false;
+}
+
+void TrajectoryPlayer::skip_forward()
+{
+    const std::size_t count = reader.get_frame_count();
+    load_frame(std::min(current + std::max<std::size_t>(1, count / 10), count - 1));
+    play_time = reader.get_simulated_time(current);
+    continuous = false;
+}
+
+void TrajectoryPlayer::skip_backward()
+{
+    const std::size_t skip = std::max<std::size_t>(1, reader.get_frame_count() / 10);
+    load_frame(current > skip ? current - skip : 0);
+    play_time = reader.get_simulated_time(current);
+    continuous = false;
+}
+
+void TrajectoryPlayer::seek_start()
+{
+    load_frame(0);
+    play_time = reader.get_simulated_time(current);
+    continuous = false;
+}
+
+void TrajectoryPlayer::seek_end()
+{
+    paused = true;
+    load_frame(reader.get_frame_count() - 1);
+    play_time = reader.get_simulated_time(current);
+    continuous = false;
+}
+
+/*----------------------------------------
+|            private methods             |
+-----------------------------------------*/
+
+void TrajectoryPlayer::run_commands()
+{
+    {
+        std::lock_guard<std::mutex> lock(command_mutex);
+        if ( pending_commands.empty() )
+            return;
+
+        running_commands.swap(pending_commands);
+    }
+
+    bool unpaused = false;
+    for ( Command command : running_commands )
+    {
+        (this->*command)();
+        unpaused = command == &TrajectoryPlayer::toggle_pause ? !paused : unpaused;
+    }
+    running_commands.clear();
+
+    // unpausing at the end plays the recording again
+    if ( unpaused && !paused && current + 1 >= reader.get_frame_count() )
+    {
+        seek_start();
+    }
+
+    // a command may have changed what is drawn, even without a new frame
+    snapshot_dirty = true;
+}
+
+void TrajectoryPlayer::load_frame(std::size_t index)
+{
+    if ( !reader.read(index, frame) )
+    {
+        std::cerr << "Error: could not decode trajectory frame " << index << std::endl;
+        return;
+    }
+
+    current = index;
+    loaded = true;
+    snapshot_dirty = true;
+}
+
+void TrajectoryPlayer::publish_snapshot()
+{
+    Snapshot& snapshot = snapshots.write_buffer();
+    const unsigned n = frame.size();
+
+    // the color of a body comes from |v|, scaled between the lowest and the highest of the frame
+    double lowest_speed = INFINITY, highest_speed = 0.0;
+    double mass = 0.0, com_x = 0.0, com_y = 0.0;
+    for ( unsigned i = 0; i < n; ++i )
+    {
+        const double speed = std::sqrt(static_cast<double>(frame.vx[i]) * frame.vx[i] + static_cast<double>(frame.vy[i]) * frame.vy[i]);
+        lowest_speed = std::min(lowest_speed, speed);
+        highest_speed = std::max(highest_speed, speed);
+
+        mass += frame.mass[i];
+        com_x += frame.mass[i] * frame.x[i];
+        com_y += frame.mass[i] * frame.y[i];
+    }
+    const double shade_scale = highest_speed > lowest_speed ? 255.0 / (highest_speed - lowest_speed) : 0.0;
+
+    // the viewer interpolates from the frame before while playing, not across seeks
+    const double frame_time = frame.simulated_time;
+    const bool interpolate = continuous && !paused && published_positions.size() == n && frame_time > published_time;
+    snapshot.previous_positions.clear();
+    if ( interpolate )
+    {
+        snapshot.previous_positions.assign(published_positions.begin(), published_positions.end());
+    }
+
+    snapshot.positions.resize(n);
+    snapshot.shades.resize(n);
+    for ( unsigned i = 0; i < n; ++i )
+    {
+        const double speed = std::sqrt(static_cast<double>(frame.vx[i]) * frame.vx[i] + static_cast<double>(frame.vy[i]) * frame.vy[i]);
+
+        snapshot.positions[i] = Vec2T<float>(frame.x[i], frame.y[i]);
+        snapshot.shades[i] = static_cast<uint8_t>(std::clamp((speed - lowest_speed) * shade_scale, 0.0, 255.0));
+    }
+
+    // the frame was due when the playback passed its time, which may have been a moment ago
+    const double late = time_rate > 0.0 ? std::max(0.0, play_time - frame_time) / time_rate : 0.0;
+    snapshot.published_at = std::chrono::steady_clock::now()
+        - std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(late));
+    snapshot.interval = interpolate ? frame_time - published_time : 0.0;
+    snapshot.time_rate = time_rate;
+
+    published_positions.assign(snapshot.positions.begin(), snapshot.positions.end());
+    published_time = frame_time;
+    continuous = true;
+
+    snapshot.velocities.clear();
+    if ( draw_vectors )
+    {
+        snapshot.velocities.resize(n);
+        for ( unsigned i = 0; i < n; ++i )
+        {
+            snapshot.velocities[i] = Vec2T<float>(frame.vx[i], frame.vy[i]);
+        }
+    }
+    snapshot.bound_lines.clear();
+
+    snapshot.center_of_mass = mass > 0.0 ? Vec2T<double>(com_x / mass, com_y / mass) : (frame.top_left + frame.bottom_right) * 0.5;
+    snapshot.top_left = frame.top_left;
+    snapshot.bottom_right = frame.bottom_right;
+
+    snapshot.paused = paused;
+    snapshot.draw_quadtree = false;
+    snapshot.draw_vectors = draw_vectors;
+    snapshot.debug = debug;
+
+    const TrajectoryHeader& header = reader.get_header();
+    snapshot.G = header.G;
+    snapshot.dt = header.dt;
+
+    snapshot.playback = true;
+    snapshot.frame = current;
+    snapshot.frame_count = reader.get_frame_count();
+    snapshot.step = frame.step;
+    snapshot.simulated_time = frame.simulated_time;
+    snapshot.num_bodies = n;
+
+    snapshots.publish();
+}
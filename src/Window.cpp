@@ -1,5 +1,7 @@
 #include "Window.h"
 
+#include <cstring>
+
 /*----------------------------------------
 |         Constructor/Destructor         |
 -----------------------------------------*/
@@ -8,17 +10,50 @@ Window::Window(int width, int height, const char* title, std::shared_ptr<Simulat
     : width(width), height(height)
 {
     this->simulation_manager = simulation_manager;
-    this->bodies = this->simulation_manager->get_bodies();
+    this->simulation_manager->enable_snapshots();
+    create(title);
+}
+
+Window::Window(int width, int height, const char* title, std::shared_ptr<TrajectoryPlayer> player)
+    : width(width), height(height)
+{
+    this->player = player;
+    create(title);
+}
+
+Window::~Window()
+{
+    delete export_texture;
+    delete vertex_pool;
+    delete window;
+}
+
+void Window::create(const char* title)
+{
+    this->snapshot = nullptr;
+    this->export_texture = nullptr;
+    this->exporting = false;
+    this->export_time = 0.0;
+    this->draw_time = 0.0;
+    this->frame_time = 0.0;
 
     this->toggle_tracking = true;
     this->isDragging = false;
+    this->isScrubbing = false;
     this->zoomFactor = 1.0;
 
+    vertex_pool = new ThreadPool(std::clamp(std::thread::hardware_concurrency() / 4, 1u, MAX_VERTEX_THREADS));
+    stars.setPrimitiveType(sf::Points);
+    stars.setUsage(sf::VertexBuffer::Stream);
+    velocity_lines.setPrimitiveType(sf::Lines);
+    velocity_lines.setUsage(sf::VertexBuffer::Stream);
+
     // WINDOW
     window = new sf::RenderWindow(sf::VideoMode(width, height), title);
 
     window->setPosition(sf::Vector2i(0, 0));
     window->setVerticalSyncEnabled(true);
+    target = window;
 
     // VIEWS
     view = new sf::View(sf::FloatRect(0, 0, width, height));
@@ -27,19 +62,74 @@ Window::Window(int width, int height, const char* title, std::shared_ptr<Simulat
     // FONT
     font = sf::Font();
     font.loadFromFile("assets/fonts/montserrat/Montserrat-Regular.otf");
-}
 
-Window::~Window()
-{
-    delete window;
+    // BODY COLORS, the same palette as the software rasterizer
+    for ( unsigned shade = 0; shade < 256; ++shade )
+    {
+        uint8_t r, g, b;
+        density_color(shade / 255.0, r, g, b);
+        shade_colors[shade] = sf::Color(r, g, b, 255);
+    }
 }
 
 /*----------------------------------------
 |             public methods             |
 -----------------------------------------*/
 
+void Window::set_exporter(std::shared_ptr<FrameExporter> exporter)
+{
+    this->exporter = exporter;
+
+    delete export_texture;
+    export_texture = new sf::RenderTexture();
+    export_texture->create(exporter->get_width(), exporter->get_height());
+
+    exporting = true;
+}
+
+void Window::run()
+{
+    // physics runs as fast as it can, the frame rate of the window does not depend on the step time
+    std::atomic<bool> running(true);
+    std::thread physics_thread([this, &running]()
+        {
+            while ( running.load(std::memory_order_relaxed) )
+            {
+                // short sleeps, so a command (or closing the window) does not wait for long
+                const double wait = std::min(player ? player->advance() : simulation_manager->advance(), 0.002);
+                if ( wait > 0.0 )
+                {
+                    std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+                }
+            }
+        });
+
+    std::chrono::high_resolution_clock::time_point last_frame = std::chrono::high_resolution_clock::now();
+    while ( window->isOpen() )
+    {
+        update();
+
+        const std::chrono::high_resolution_clock::time_point now = std::chrono::high_resolution_clock::now();
+        frame_time = std::chrono::duration<double, std::milli>(now - last_frame).count();
+        last_frame = now;
+    }
+
+    running = false;
+    physics_thread.join();
+
+    // the frames still being encoded
+    if ( exporter )
+    {
+        exporter->flush();
+    }
+}
+
 void Window::update()
 {
+    const std::chrono::high_resolution_clock::time_point start_time = std::chrono::high_resolution_clock::now();
+
+    snapshot = player ? &player->latest_snapshot() : &simulation_manager->latest_snapshot();
+
     window->clear();
     window->setView(*view);
 
@@ -51,6 +141,15 @@ void Window::update()
     }
 
     draw_everything();
+    draw_time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+
+    // every snapshot once, redrawing a paused one would only export the same image again
+    if ( exporting && snapshot->published_at != exported_at )
+    {
+        export_frame();
+        exported_at = snapshot->published_at;
+    }
+
     window->display();
 }
 
@@ -81,115 +180,151 @@ void Window::draw_everything()
 {
     draw_bodies();
 
-    if ( simulation_manager->get_toggle_draw_vectors() )
+    if ( snapshot->draw_vectors )
     {
         draw_velocity_vectors();
     }
 
-    if ( simulation_manager->get_toggle_draw_quadtree() )
+    if ( snapshot->draw_quadtree )
     {
         draw_quadtree_bounds();
     }
 
-    if ( simulation_manager->get_toggle_debug() )
+    if ( snapshot->playback )
+    {
+        draw_timeline();
+    }
+
+    if ( snapshot->debug )
     {
         draw_ui();
     }
 }
 
-void Window::draw_bodies()
+void Window::draw_vertices(sf::VertexBuffer& buffer, const std::vector<sf::Vertex>& vertices, sf::PrimitiveType type)
 {
-    double interpolation_cutoff = 0.5;
+    if ( vertices.empty() )
+        return;
 
-    sf::Color low_density_color = sf::Color(0, 128, 255);     // Light blue
-    sf::Color mid_density_color = sf::Color(255, 0, 255);     // Magenta
-    sf::Color high_density_color = sf::Color(255, 255, 0);    // Yellow
+    // without vertex buffers (old gl) they are drawn straight from memory
+    if ( !sf::VertexBuffer::isAvailable() )
+    {
+        target->draw(vertices.data(), vertices.size(), type);
+        return;
+    }
 
-    auto interpolateColor = [&](double t) -> sf::Color // t is in range [0, 1]
+    // with some room, so a slowly growing body count does not create a new buffer every frame
+    if ( buffer.getVertexCount() < vertices.size() )
     {
-        if ( t < interpolation_cutoff )
-        {
-            double t2 = t / interpolation_cutoff;
-            sf::Uint8 r = static_cast<sf::Uint8>(low_density_color.r * (1.0 - t2) + mid_density_color.r * t2);
-            sf::Uint8 g = static_cast<sf::Uint8>(low_density_color.g * (1.0 - t2) + mid_density_color.g * t2);
-            sf::Uint8 b = static_cast<sf::Uint8>(low_density_color.b * (1.0 - t2) + mid_density_color.b * t2);
+        buffer.create(vertices.size() + vertices.size() / 4);
+    }
 
-            return sf::Color(r, g, b, 255);
-        }
-        else
-        {
-            double t2 = (t - interpolation_cutoff) / (1 - interpolation_cutoff);
-            sf::Uint8 r = static_cast<sf::Uint8>(mid_density_color.r * (1.0 - t2) + high_density_color.r * t2);
-            sf::Uint8 g = static_cast<sf::Uint8>(mid_density_color.g * (1.0 - t2) + high_density_color.g * t2);
-            sf::Uint8 b = static_cast<sf::Uint8>(mid_density_color.b * (1.0 - t2) + high_density_color.b * t2);
+    buffer.update(vertices.data(), vertices.size(), 0);
+    target->draw(buffer, 0, vertices.size());
+}
 
-            return sf::Color(r, g, b, 255);
-        }
-    };
+void Window::draw_bodies()
+{
+    const std::vector<Vec2T<float>>& positions = snapshot->positions;
+    const std::vector<Vec2T<float>>& previous = snapshot->previous_positions;
 
-    double highest_density = bodies->get_highest_density();
-    double lowest_density = bodies->get_lowest_density();
+    const std::vector<uint8_t>& shades = snapshot->shades;
+    const unsigned count = static_cast<unsigned>(positions.size());
 
-    sf::VertexArray stars(sf::Points);
+    star_vertices.resize(count);
 
-    for ( unsigned i = 0; i < bodies->get_size(); ++i )
+    // with a fixed time rate the bodies are drawn between the last two states, at the simulated time that passed since
+    if ( previous.size() == positions.size() && snapshot->interval > 0.0 )
     {
-        double normalized_density = (bodies->acc[i].length() - lowest_density) / (highest_density - lowest_density);
-
-        sf::Color color = interpolateColor(normalized_density);
-
-        sf::Vector2f position(bodies->pos[i].x, bodies->pos[i].y);
-
-        stars.append(sf::Vertex(position, color));
+        const double since = std::chrono::duration<double>(std::chrono::steady_clock::now() - snapshot->published_at).count();
+        const float alpha = static_cast<float>(std::min(1.0, since * snapshot->time_rate / snapshot->interval));
+
+        vertex_pool->parallel_for(0, count, [&](unsigned start, unsigned end, unsigned)
+            {
+                for ( unsigned i = start; i < end; ++i )
+                {
+                    const Vec2T<float> position = previous[i] + (positions[i] - previous[i]) * alpha;
+                    star_vertices[i] = sf::Vertex(sf::Vector2f(position.x, position.y), shade_colors[shades[i]]);
+                }
+            }, 16384);
+    }
+    else
+    {
+        vertex_pool->parallel_for(0, count, [&](unsigned start, unsigned end, unsigned)
+            {
+                for ( unsigned i = start; i < end; ++i )
+                {
+                    star_vertices[i] = sf::Vertex(sf::Vector2f(positions[i].x, positions[i].y), shade_colors[shades[i]]);
+                }
+            }, 16384);
     }
 
-    window->draw(stars);
+    draw_vertices(stars, star_vertices, sf::Points);
 }
 
 void Window::draw_velocity_vectors()
 {
     const double lineLengthMultiplier = 1.0;
 
-    sf::VertexArray lines(sf::Lines);
-    lines.resize(bodies->get_size() * 2);
+    const std::vector<Vec2T<float>>& positions = snapshot->positions;
+    const std::vector<Vec2T<float>>& velocities = snapshot->velocities;
 
-    double* cosValues = new double[bodies->get_size()];
-    double* sinValues = new double[bodies->get_size()];
+    // the first snapshot after switching the vectors on may not have them yet
+    const unsigned count = static_cast<unsigned>(std::min(positions.size(), velocities.size()));
 
-    for ( unsigned i = 0; i < bodies->get_size(); ++i )
-    {
-        double angle = atan2(bodies->vel[i].y, bodies->vel[i].x);
-        cosValues[i] = cos(angle);
-        sinValues[i] = sin(angle);
-    }
-
-    for ( unsigned i = 0; i < bodies->get_size(); ++i )
-    {
-        double length = bodies->vel[i].length() * lineLengthMultiplier;
+    velocity_vertices.resize(2 * static_cast<size_t>(count));
+    vertex_pool->parallel_for(0, count, [&](unsigned start, unsigned end, unsigned)
+        {
+            for ( unsigned i = start; i < end; ++i )
+            {
+                sf::Vector2f startPos(positions[i].x, positions[i].y);
+                sf::Vector2f endPos(
+                    positions[i].x + velocities[i].x * lineLengthMultiplier,
+                    positions[i].y + velocities[i].y * lineLengthMultiplier
+                );
+
+                velocity_vertices[2 * i] = sf::Vertex(startPos, sf::Color(255, 255, 255, 50));
+                velocity_vertices[2 * i + 1] = sf::Vertex(endPos, sf::Color(255, 255, 255, 150));
+            }
+        }, 16384);
+
+    draw_vertices(velocity_lines, velocity_vertices, sf::Lines);
+}
 
-        sf::Vector2f startPos(bodies->pos[i].x, bodies->pos[i].y);
-        sf::Vector2f endPos(
-            bodies->pos[i].x + cosValues[i] * length,
-            bodies->pos[i].y + sinValues[i] * length
-        );
+void Window::draw_quadtree_bounds()
+{
+    const std::vector<Vec2T<float>>& lines = snapshot->bound_lines;
 
-        lines.append(sf::Vertex(startPos, sf::Color(255, 255, 255, 50)));
-        lines.append(sf::Vertex(endPos, sf::Color(255, 255, 255, 150)));
+    quadtree_lines.setPrimitiveType(sf::Lines);
+    quadtree_lines.resize(lines.size());
+    for ( size_t i = 0; i < lines.size(); ++i )
+    {
+        quadtree_lines[i] = sf::Vertex(sf::Vector2f(lines[i].x, lines[i].y), sf::Color(0, 255, 0, 100));
     }
 
-    window->draw(lines);
-
-    delete[] cosValues;
-    delete[] sinValues;
-
-    lines.clear();
+    target->draw(quadtree_lines);
 }
 
-void Window::draw_quadtree_bounds()
+void Window::draw_timeline()
 {
-    sf::VertexArray* lines = simulation_manager->get_bounding_rectangles();
+    window->setView(*ui_view);
 
-    window->draw(*lines);
+    // the whole recording along the bottom, the played part filled in. dragging with the right mouse button scrubs
+    const float y = height - 20.0f;
+    const float played = snapshot->frame_count > 1 ? static_cast<float>(snapshot->frame) / (snapshot->frame_count - 1) : 1.0f;
+    const float end = 20.0f + played * (width - 40.0f);
+
+    const sf::Vertex timeline[] = {
+        sf::Vertex(sf::Vector2f(20.0f, y), sf::Color(100, 100, 100, 150)),
+        sf::Vertex(sf::Vector2f(width - 20.0f, y), sf::Color(100, 100, 100, 150)),
+        sf::Vertex(sf::Vector2f(20.0f, y), sf::Color(255, 255, 255, 255)),
+        sf::Vertex(sf::Vector2f(end, y), sf::Color(255, 255, 255, 255)),
+        sf::Vertex(sf::Vector2f(end, y - 8.0f), sf::Color(255, 255, 255, 255)),
+        sf::Vertex(sf::Vector2f(end, y + 8.0f), sf::Color(255, 255, 255, 255)),
+    };
+    window->draw(timeline, 6, sf::Lines);
+
+    window->setView(*view);
 }
 
 void Window::draw_ui()
@@ -204,8 +339,8 @@ void Window::draw_ui()
     statusText.setPosition(left_offset, top_offset);
     statusText.setFont(font);
     statusText.setOutlineColor(sf::Color::Black);
-    statusText.setFillColor(simulation_manager->get_toggle_paused() ? sf::Color::Red : sf::Color::Green);
-    statusText.setString(simulation_manager->get_toggle_paused() ? "PAUSED" : "RUNNING");
+    statusText.setFillColor(snapshot->paused ? sf::Color::Red : sf::Color::Green);
+    statusText.setString(snapshot->paused ? "PAUSED" : snapshot->playback ? "PLAYING" : "RUNNING");
 
     sf::Text names;
     names.setPosition(left_offset, top_offset + statusText.getLocalBounds().height + spacing);
@@ -220,12 +355,19 @@ void Window::draw_ui()
         << "|    FPS:\n"
         << "|--\n"
         << "|    G:\n"
+        << "|    method:\n"
+        << "|    integrator:\n"
         << "|    theta:\n"
         << "|    dt:\n"
+        << "|    time rate:\n"
         << "|--\n"
         << "|    physics:\n"
+        << "|    tree:\n"
         << "|    drawing:\n"
         << "|    TOTAL:\n"
+        << "|    imbalance:\n"
+        << "|    leaf size:\n"
+        << "|    active:\n"
         << "|--\n"
         << "|    calc/frame:\n"
         << "|    total calc:\n"
@@ -244,23 +386,51 @@ void Window::draw_ui()
 
     std::stringstream valueStream;
 
-    bool toggleDrawQuadtree = simulation_manager->get_toggle_draw_quadtree();
-    bool toggleDrawVectors = simulation_manager->get_toggle_draw_vectors();
+    bool toggleDrawQuadtree = snapshot->draw_quadtree;
+    bool toggleDrawVectors = snapshot->draw_vectors;
 
     valueStream << std::left
-        << simulation_manager->get_step() << "\n"
-        << simulation_manager->get_num_particles() << "\n\n"
-        << std::fixed << std::setprecision(3) << simulation_manager->get_fps() << "\n\n"
-        << std::scientific << std::setprecision(4) << simulation_manager->get_G() << "\n"
-        << std::fixed << std::setprecision(1) << simulation_manager->get_theta() << "\n"
-        << std::fixed << std::setprecision(2) << simulation_manager->get_dt() << "\n\n"
-        << simulation_manager->get_elapsed_time_physics() << " ms\n"
-        << simulation_manager->get_elapsed_time_graphics() << " ms\n"
-        << simulation_manager->get_total_frame_time() << " ms\n\n"
-        << std::setprecision(2) << std::scientific << static_cast<double>(simulation_manager->get_interactions_per_frame()) << "\n"
-        << std::setprecision(2) << std::scientific << static_cast<double>(simulation_manager->get_total_interactions()) << "\n\n" << std::fixed
-        << std::setprecision(2) << simulation_manager->get_current_ratio_best_case() << "x     (~" << simulation_manager->get_average_ratio_best_case() << ")\n"
-        << std::setprecision(2) << simulation_manager->get_current_ratio_worst_case() << "x     (~" << simulation_manager->get_average_ratio_worst_case() << ")\n";
+        << snapshot->step
+        << (snapshot->recording ? "     (recording " + std::to_string(snapshot->recorded_frames) + " frames, " + std::to_string(snapshot->recorded_bytes >> 20)
+            + " MB, " + std::to_string(snapshot->dropped_frames) + " dropped)" : std::string()) << "\n"
+        << snapshot->num_bodies
+        << (snapshot->collisions ? "     (" + std::to_string(snapshot->total_merges) + " merged)" : std::string()) << "\n\n"
+        << std::fixed << std::setprecision(3) << 1000.0 / std::max(frame_time, 1e-3) << "\n\n"
+        << std::scientific << std::setprecision(4) << snapshot->G << "\n"
+        << (snapshot->fast_multipole ? "FMM     (p = " + std::to_string(snapshot->multipole_order) + ")" : std::string("BARNES-HUT")) << "\n"
+        << (snapshot->integrator == VELOCITY_VERLET ? "VELOCITY VERLET" : "LEAPFROG KDK") << "\n"
+        << std::fixed << std::setprecision(1) << snapshot->theta << "\n"
+        << std::fixed << std::setprecision(2) << snapshot->dt << "\n";
+
+    if ( snapshot->playback )
+    {
+        valueStream << snapshot->time_rate << " / s     (frame " << snapshot->frame + 1 << " / " << snapshot->frame_count << ")\n\n";
+    }
+    else if ( snapshot->time_rate > 0.0 )
+    {
+        valueStream << snapshot->time_rate << " / s     (catch up " << snapshot->max_catch_up_steps << ", dropped " << snapshot->dropped_time << ")\n\n";
+    }
+    else
+    {
+        valueStream << "FREE RUNNING\n\n";
+    }
+
+    valueStream
+        << snapshot->physics_time << " ms\n"
+        << snapshot->tree_time << " ms  " << (snapshot->last_was_refit ? "refit" : "rebuild")
+        << "  (" << snapshot->refit_count << " / " << snapshot->rebuild_count << ")\n"
+        << draw_time << " ms"
+        << (exporter ? "     (export " + std::to_string(static_cast<int>(export_time)) + " ms, " + std::to_string(exporter->get_exported_frames())
+            + " frames" + (exporting ? ")" : ", stopped)") : std::string()) << "\n"
+        << frame_time << " ms\n"
+        << snapshot->load_imbalance << "x     (" << snapshot->num_threads << " threads)\n"
+        << snapshot->leaf_capacity << (snapshot->auto_tune_leaf_capacity ? "     (auto)" : "") << "\n"
+        << std::setprecision(1) << 100.0 * snapshot->active_fraction << " %     ("
+        << snapshot->max_time_level + 1 << " levels, " << std::setprecision(2) << snapshot->forces_per_body << " forces/body)\n\n"
+        << std::setprecision(2) << std::scientific << snapshot->interactions_per_frame << "\n"
+        << std::setprecision(2) << std::scientific << snapshot->total_interactions << "\n\n" << std::fixed
+        << std::setprecision(2) << snapshot->ratio_best_case << "x     (~" << snapshot->average_ratio_best_case << ")\n"
+        << std::setprecision(2) << snapshot->ratio_worst_case << "x     (~" << snapshot->average_ratio_worst_case << ")\n";
 
     values.setString(valueStream.str());
 
@@ -270,7 +440,7 @@ void Window::draw_ui()
     toggleText.setCharacterSize(20);
     toggleText.setOutlineColor(sf::Color::Black);
     toggleText.setFillColor(sf::Color::White);
-    toggleText.setString("DRAW QUADTREE:\nDRAW VECTORS:\nTRACKING:\n");
+    toggleText.setString("DRAW QUADTREE:\nDRAW VECTORS:\nTRACKING:\nLOAD BALANCING:\nQUADRUPOLES:\nREFIT:\n");
 
     sf::Text toggleQuadtree;
     toggleQuadtree.setPosition(left_offset + names.getLocalBounds().width + spacing, toggleText.getPosition().y);
@@ -296,6 +466,36 @@ void Window::draw_ui()
     toggleTracking.setFillColor(this->toggle_tracking ? sf::Color::Green : sf::Color::Red);
     toggleTracking.setString(this->toggle_tracking ? "TRUE" : "FALSE");
 
+    bool toggleLoadBalancing = snapshot->load_balancing;
+
+    sf::Text toggleBalancing;
+    toggleBalancing.setPosition(left_offset + names.getLocalBounds().width + spacing, toggleTracking.getPosition().y + toggleTracking.getLocalBounds().height + 8);
+    toggleBalancing.setFont(font);
+    toggleBalancing.setCharacterSize(20);
+    toggleBalancing.setOutlineColor(sf::Color::Black);
+    toggleBalancing.setFillColor(toggleLoadBalancing ? sf::Color::Green : sf::Color::Red);
+    toggleBalancing.setString(toggleLoadBalancing ? "TRUE" : "FALSE");
+
+    bool toggleQuadrupole = snapshot->quadrupole;
+
+    sf::Text toggleQuadrupoles;
+    toggleQuadrupoles.setPosition(left_offset + names.getLocalBounds().width + spacing, toggleBalancing.getPosition().y + toggleBalancing.getLocalBounds().height + 8);
+    toggleQuadrupoles.setFont(font);
+    toggleQuadrupoles.setCharacterSize(20);
+    toggleQuadrupoles.setOutlineColor(sf::Color::Black);
+    toggleQuadrupoles.setFillColor(toggleQuadrupole ? sf::Color::Green : sf::Color::Red);
+    toggleQuadrupoles.setString(toggleQuadrupole ? "TRUE" : "FALSE");
+
+    bool toggleRefit = snapshot->refit;
+
+    sf::Text toggleRefitText;
+    toggleRefitText.setPosition(left_offset + names.getLocalBounds().width + spacing, toggleQuadrupoles.getPosition().y + toggleQuadrupoles.getLocalBounds().height + 8);
+    toggleRefitText.setFont(font);
+    toggleRefitText.setCharacterSize(20);
+    toggleRefitText.setOutlineColor(sf::Color::Black);
+    toggleRefitText.setFillColor(toggleRefit ? sf::Color::Green : sf::Color::Red);
+    toggleRefitText.setString(toggleRefit ? "TRUE" : "FALSE");
+
     // Combine similar draw operations
     window->draw(statusText);
     window->draw(names);
@@ -304,10 +504,47 @@ void Window::draw_ui()
     window->draw(toggleQuadtree);
     window->draw(toggleVectors);
     window->draw(toggleTracking);
+    window->draw(toggleBalancing);
+    window->draw(toggleQuadrupoles);
+    window->draw(toggleRefitText);
 
     window->setView(*view);
 }
 
+void Window::export_frame()
+{
+    const std::chrono::high_resolution_clock::time_point start_time = std::chrono::high_resolution_clock::now();
+
+    // the scene without the ui, around the same center and as wide as the window shows it
+    sf::View export_view = *view;
+    export_view.setSize(sf::Vector2f(view->getSize().x, view->getSize().x * exporter->get_height() / exporter->get_width()));
+
+    target = export_texture;
+    export_texture->clear();
+    export_texture->setView(export_view);
+
+    draw_bodies();
+
+    if ( snapshot->draw_vectors )
+    {
+        draw_velocity_vectors();
+    }
+
+    if ( snapshot->draw_quadtree )
+    {
+        draw_quadtree_bounds();
+    }
+
+    export_texture->display();
+    target = window;
+
+    // the readback is the only part on this thread, encoding and writing happen on the exporter threads
+    const sf::Image image = export_texture->getTexture().copyToImage();
+    std::memcpy(exporter->acquire(), image.getPixelsPtr(), 4ul * exporter->get_width() * exporter->get_height());
+    exporter->submit();
+
+    export_time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+}
 
 /*--------------------
 |    event handling   |
@@ -325,7 +562,19 @@ void Window::handle_events()
         }
         else if ( event.type == sf::Event::KeyPressed )
         {
-            settings_events(event);
+            // the same in both modes, the export belongs to the window
+            if ( event.key.code == sf::Keyboard::E && exporter )
+            {
+                exporting = !exporting;
+            }
+            else if ( player )
+            {
+                playback_events(event);
+            }
+            else
+            {
+                settings_events(event);
+            }
         }
         else if ( event.type == sf::Event::MouseWheelScrolled )
         {
@@ -355,42 +604,67 @@ void Window::settings_events(sf::Event& event)
 
     else if ( event.key.code == sf::Keyboard::Space )
     {
-        simulation_manager->toggle_pause();
+        simulation_manager->post(&SimulationManager::toggle_pause);
     }
 
     else if ( event.key.code == sf::Keyboard::Q )
     {
-        simulation_manager->toggle_draw_quadtree();
+        simulation_manager->post(&SimulationManager::toggle_draw_quadtree);
     }
 
     else if ( event.key.code == sf::Keyboard::V )
     {
-        simulation_manager->toggle_draw_vectors();
+        simulation_manager->post(&SimulationManager::toggle_draw_vectors);
     }
 
     else if ( event.key.code == sf::Keyboard::D )
     {
-        simulation_manager->toggle_debug_info();
+        simulation_manager->post(&SimulationManager::toggle_debug_info);
     }
 
     else if ( event.key.code == sf::Keyboard::Right )
     {
-        simulation_manager->increase_dt();
+        simulation_manager->post(&SimulationManager::increase_dt);
     }
 
     else if ( event.key.code == sf::Keyboard::Left )
     {
-        simulation_manager->decrease_dt();
+        simulation_manager->post(&SimulationManager::decrease_dt);
+    }
+
+    else if ( event.key.code == sf::Keyboard::S )
+    {
+        simulation_manager->post(&SimulationManager::save_checkpoint);
+    }
+
+    else if ( event.key.code == sf::Keyboard::O )
+    {
+        simulation_manager->post(&SimulationManager::toggle_recording);
+    }
+
+    else if ( event.key.code == sf::Keyboard::Period )
+    {
+        simulation_manager->post(&SimulationManager::increase_time_rate);
+    }
+
+    else if ( event.key.code == sf::Keyboard::Comma )
+    {
+        simulation_manager->post(&SimulationManager::decrease_time_rate);
+    }
+
+    else if ( event.key.code == sf::Keyboard::X )
+    {
+        simulation_manager->post(&SimulationManager::toggle_fixed_timestep);
     }
 
     else if ( event.key.code == sf::Keyboard::Up )
     {
-        simulation_manager->increase_G();
+        simulation_manager->post(&SimulationManager::increase_G);
     }
 
     else if ( event.key.code == sf::Keyboard::Down )
     {
-        simulation_manager->decrease_G();
+        simulation_manager->post(&SimulationManager::decrease_G);
     }
 
     else if ( event.key.code == sf::Keyboard::Enter )
@@ -407,10 +681,123 @@ void Window::settings_events(sf::Event& event)
         this->toggle_tracking = !this->toggle_tracking;
     }
 
+    else if ( event.key.code == sf::Keyboard::B )
+    {
+        simulation_manager->post(&SimulationManager::toggle_load_balancing);
+    }
+
+    else if ( event.key.code == sf::Keyboard::F )
+    {
+        simulation_manager->post(&SimulationManager::toggle_force_method);
+    }
+
+    else if ( event.key.code == sf::Keyboard::U )
+    {
+        simulation_manager->post(&SimulationManager::toggle_refit);
+    }
+
+    else if ( event.key.code == sf::Keyboard::K )
+    {
+        simulation_manager->post(&SimulationManager::toggle_integrator);
+    }
+
+    else if ( event.key.code == sf::Keyboard::J )
+    {
+        simulation_manager->post(&SimulationManager::toggle_block_timesteps);
+    }
+
+    else if ( event.key.code == sf::Keyboard::C )
+    {
+        simulation_manager->post(&SimulationManager::toggle_collisions);
+    }
+
+    else if ( event.key.code == sf::Keyboard::M )
+    {
+        simulation_manager->post(&SimulationManager::toggle_quadrupole);
+    }
+
+    else if ( event.key.code == sf::Keyboard::L )
+    {
+        simulation_manager->post(&SimulationManager::toggle_auto_tune_leaf_capacity);
+    }
+
+    else if ( event.key.code == sf::Keyboard::I )
+    {
+        simulation_manager->post(&SimulationManager::toggle_verbose_info);
+    }
+
     else if ( event.key.code == sf::Keyboard::R )
     {
-        simulation_manager->toggle_pause();
-        simulation_manager->reset_simulation();
+        simulation_manager->post(&SimulationManager::toggle_pause);
+        simulation_manager->post(&SimulationManager::reset_simulation);
+    }
+}
+
+void Window::playback_events(sf::Event& event)
+{
+    if ( event.key.code == sf::Keyboard::Escape )
+    {
+        this->window->close();
+    }
+
+    else if ( event.key.code == sf::Keyboard::Space )
+    {
+        player->post(&TrajectoryPlayer::toggle_pause);
+    }
+
+    else if ( event.key.code == sf::Keyboard::Right )
+    {
+        player->post(&TrajectoryPlayer::step_forward);
+    }
+
+    else if ( event.key.code == sf::Keyboard::Left )
+    {
+        player->post(&TrajectoryPlayer::step_backward);
+    }
+
+    else if ( event.key.code == sf::Keyboard::PageUp )
+    {
+        player->post(&TrajectoryPlayer::skip_forward);
+    }
+
+    else if ( event.key.code == sf::Keyboard::PageDown )
+    {
+        player->post(&TrajectoryPlayer::skip_backward);
+    }
+
+    else if ( event.key.code == sf::Keyboard::Home )
+    {
+        player->post(&TrajectoryPlayer::seek_start);
+    }
+
+    else if ( event.key.code == sf::Keyboard::End )
+    {
+        player->post(&TrajectoryPlayer::seek_end);
+    }
+
+    else if ( event.key.code == sf::Keyboard::Period )
+    {
+        player->post(&TrajectoryPlayer::faster);
+    }
+
+    else if ( event.key.code == sf::Keyboard::Comma )
+    {
+        player->post(&TrajectoryPlayer::slower);
+    }
+
+    else if ( event.key.code == sf::Keyboard::V )
+    {
+        player->post(&TrajectoryPlayer::toggle_draw_vectors);
+    }
+
+    else if ( event.key.code == sf::Keyboard::D )
+    {
+        player->post(&TrajectoryPlayer::toggle_debug_info);
+    }
+
+    else if ( event.key.code == sf::Keyboard::T )
+    {
+        this->toggle_tracking = !this->toggle_tracking;
     }
 }
 
@@ -433,6 +820,13 @@ void Window::handle_mouse_wheel(const sf::Event::MouseWheelScrollEvent& event)
 
 void Window::handle_mouse_press(const sf::Event::MouseButtonEvent& event)
 {
+    if ( player && event.button == sf::Mouse::Right )
+    {
+        isScrubbing = true;
+        scrub(event.x, true);
+        return;
+    }
+
     toggle_tracking = false;
     if ( event.button == sf::Mouse::Left )
     {
@@ -443,6 +837,17 @@ void Window::handle_mouse_press(const sf::Event::MouseButtonEvent& event)
 
 void Window::handle_mouse_release(const sf::Event::MouseButtonEvent& event)
 {
+    if ( event.button == sf::Mouse::Right )
+    {
+        // while dragging only keyframes are shown, the exact frame once the button is released
+        if ( isScrubbing )
+        {
+            scrub(event.x, false);
+        }
+        isScrubbing = false;
+        return;
+    }
+
     toggle_tracking = false;
     if ( event.button == sf::Mouse::Left )
     {
@@ -452,6 +857,11 @@ void Window::handle_mouse_release(const sf::Event::MouseButtonEvent& event)
 
 void Window::handle_mouse_move(const sf::Event::MouseMoveEvent& event)
 {
+    if ( isScrubbing )
+    {
+        scrub(event.x, true);
+    }
+
     if ( isDragging )
     {
         sf::Vector2i mousePos(event.x, event.y);
@@ -464,23 +874,16 @@ void Window::handle_mouse_move(const sf::Event::MouseMoveEvent& event)
     }
 }
 
-void Window::reset_view()
+void Window::scrub(int x, bool keyframe_only)
 {
-    view->setCenter(sf::Vector2f(simulation_manager->get_center_of_mass().x, simulation_manager->get_center_of_mass().y));
-
-    Vec2 top_left, bottom_right;
-    simulation_manager->get_quadtree_size(top_left.x, top_left.y, bottom_right.x, bottom_right.y);
-    view->setSize(sf::Vector2f(bottom_right.x * 1.6, bottom_right.y * 1.6));
+    // the same span as the timeline
+    player->seek((x - 20.0) / std::max(1.0, width - 40.0), keyframe_only);
 }
 
-/*----------------------------------------
-|              old methods               |
------------------------------------------*/
-
-void Window::store_png(const std::string& filename)
+void Window::reset_view()
 {
-    sf::Texture texture;
-    texture.create(this->width, this->height);
-    texture.update(*window);
-    texture.copyToImage().saveToFile(filename);
+    view->setCenter(sf::Vector2f(snapshot->center_of_mass.x, snapshot->center_of_mass.y));
+
+    const Vec2T<double> size = snapshot->bottom_right - snapshot->top_left;
+    view->setSize(sf::Vector2f(size.x * 1.6, size.y * 1.6));
 }
@@ -0,0 +1,106 @@
+#include "Config.h"
+#include "Rasterizer.h"
+#include "SimulationManager.h"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+/*
+runs the simulation without a window, every cycle goes to the physics.
+reads the same CONFIG.cfg as the viewer and prints the throughput every tenth of the run.
+with export = 1 every export_every-th step is drawn with the software rasterizer and written by the exporter,
+showing the area the viewer starts with.
+
+usage: gravity_headless [steps] [config_file]
+*/
+
+int main(int argc, char** argv)
+{
+    const unsigned long steps = argc > 1 ? std::stoul(argv[1]) : 1000;
+    const std::string config_file = argc > 2 ? argv[2] : "CONFIG.cfg";
+    const unsigned long report_every = std::max(1ul, steps / 10);
+
+    Config config;
+    if ( !read_config(config_file, config) )
+    {
+        std::cerr << "could not open " << config_file << ", using the defaults" << std::endl;
+    }
+
+    std::shared_ptr<SimulationManager> simulation_manager = create_simulation(config);
+    simulation_manager->toggle_pause();
+
+    std::shared_ptr<FrameExporter> exporter = config.export_frames ? create_exporter(config) : nullptr;
+    std::unique_ptr<Rasterizer> rasterizer;
+    if ( exporter )
+    {
+        // as wide as the window, the height follows the aspect of the image
+        rasterizer = std::make_unique<Rasterizer>(exporter->get_width(), exporter->get_height());
+        const double view_height = static_cast<double>(config.width) * exporter->get_height() / exporter->get_width();
+        rasterizer->set_view(0.0, 0.5 * (config.height - view_height), config.width, view_height);
+    }
+    const unsigned long export_every = std::max(1u, config.export_every);
+    double render_time = 0.0;
+
+    std::cout << static_cast<unsigned>(simulation_manager->get_num_particles()) << " bodies, " << steps << " steps, "
+        << simulation_manager->get_num_threads() << " threads\n\n";
+    std::cout << std::left << std::setw(10) << "step" << std::setw(14) << "bodies" << std::setw(14) << "ms/step"
+        << std::setw(16) << "steps/s" << "interactions/s" << std::endl;
+
+    double total_time = 0.0;
+    double window_time = 0.0;
+    double window_interactions = 0.0;
+    for ( unsigned long step = 1; step <= steps; ++step )
+    {
+        simulation_manager->step();
+
+        // ms
+        const double step_time = simulation_manager->get_elapsed_time_physics();
+        total_time += step_time;
+        window_time += step_time;
+        window_interactions += simulation_manager->get_interactions_per_frame();
+
+        // between two steps the pool of the simulation is idle
+        if ( rasterizer && step % export_every == 0 )
+        {
+            const Bodies& bodies = *simulation_manager->get_bodies();
+            rasterizer->render(simulation_manager->get_thread_pool(), bodies.x.data(), bodies.y.data(), bodies.get_size(), exporter->acquire());
+            exporter->submit();
+            render_time += rasterizer->get_render_time();
+        }
+
+        if ( step % report_every == 0 || step == steps )
+        {
+            const unsigned long window_steps = step % report_every == 0 ? report_every : step % report_every;
+
+            std::cout << std::left << std::setw(10) << step << std::setw(14) << static_cast<unsigned>(simulation_manager->get_num_particles())
+                << std::setw(14) << std::fixed << std::setprecision(3) << window_time / window_steps
+                << std::setw(16) << std::setprecision(2) << 1000.0 * window_steps / window_time
+                << std::scientific << std::setprecision(3) << 1000.0 * window_interactions / window_time << std::defaultfloat << std::endl;
+
+            window_time = 0.0;
+            window_interactions = 0.0;
+        }
+    }
+
+    std::cout << "\n" << std::fixed << std::setprecision(3) << total_time / 1000.0 << " s, "
+        << std::setprecision(3) << total_time / steps << " ms/step, "
+        << std::scientific << std::setprecision(3) << simulation_manager->get_total_interactions() * 1000.0 / total_time << " interactions/s"
+        << std::defaultfloat << std::endl;
+
+    if ( exporter )
+    {
+        exporter->flush();
+        std::cout << exporter->get_exported_frames() << " frames exported, " << std::fixed << std::setprecision(3)
+            << render_time / std::max(1ul, exporter->get_submitted_frames()) << " ms/frame drawing, "
+            << exporter->get_encode_time() / std::max(1ul, exporter->get_exported_frames()) << " ms/frame encoding"
+            << std::defaultfloat << std::endl;
+    }
+
+    if ( simulation_manager->get_toggle_collisions() )
+    {
+        std::cout << simulation_manager->get_total_merges() << " merges" << std::endl;
+    }
+
+    return 0;
+}
@@ -1,42 +1,8 @@
+#include "Config.h"
 #include "SimulationManager.h"
+#include "TrajectoryPlayer.h"
 #include "Window.h"
 
-#include <fstream>
-
-void readConfig(const std::string& configFile, double& G, double& theta, double& dt, unsigned& body_count, double& mass, int& height, int& width)
-{
-    std::ifstream file(configFile);
-    std::string line;
-
-    while ( std::getline(file, line) )
-    {
-        if ( line.empty() || line[0] == '#' )
-            continue;
-
-        size_t delimiterPos = line.find('=');
-        if ( delimiterPos != std::string::npos )
-        {
-            std::string key = line.substr(0, delimiterPos);
-            std::string value = line.substr(delimiterPos + 1);
-
-            if ( key == "G" )
-                G = std::stod(value);
-            else if ( key == "theta" )
-                theta = std::stod(value);
-            else if ( key == "dt" )
-                dt = std::stod(value);
-            else if ( key == "body_count" )
-                body_count = std::stoul(value);
-            else if ( key == "mass" )
-                mass = std::stod(value);
-            else if ( key == "height" )
-                height = std::stoi(value);
-            else if ( key == "width" )
-                width = std::stoi(value);
-        }
-    }
-}
-
 /*
 enum BodyType {
     SPINNING_CIRCLE,
@@ -48,25 +14,43 @@ enum BodyType {
 };
 */
 
-int main()
+static void export_frames(Window* window, const Config& config)
 {
-    double G = 6.67408e-3; // 10e8 stronger gravity
-    double theta = 1.2;
-    double dt = 0.05;
-    unsigned body_count = 100000;
-    double mass = 10;
-    int height = 2200;
-    int width = 2200;
+    std::shared_ptr<FrameExporter> exporter = create_exporter(config);
+    if ( exporter )
+        window->set_exporter(exporter);
+}
 
-    //readConfig("../CONFIG.cfg", G, theta, dt, body_count, mass, height, width);
-    SimulationManager* simulation_manager = new SimulationManager(width, height, "N-Body Simulation", G, theta, dt);
+int main(int argc, char** argv)
+{
+    // next to the executable, or one level up when it runs from the build folder
+    Config config;
+    if ( !read_config("CONFIG.cfg", config) && !read_config("../CONFIG.cfg", config) )
+    {
+        std::cerr << "could not open CONFIG.cfg, using the defaults" << std::endl;
+    }
+
+    // gravity_sim <trajectory> plays a recording back instead of simulating
+    if ( argc > 1 )
+    {
+        std::shared_ptr<TrajectoryPlayer> player = std::make_shared<TrajectoryPlayer>();
+        if ( !player->open(argv[1]) )
+            return 1;
+
+        Window* window = new Window(config.width, config.height, "N-Body Simulation (playback)", player);
+        if ( config.export_frames )
+            export_frames(window, config);
+        window->run();
+        return 0;
+    }
+
+    std::shared_ptr<SimulationManager> simulation_manager = create_simulation(config);
 
-    simulation_manager->add_bodies(body_count, mass, BodyType::RANDOM);
     simulation_manager->toggle_debug_info();
     simulation_manager->toggle_pause();
 
-    Window* window = new Window(width, height, "N-Body Simulation", std::unique_ptr<SimulationManager>(simulation_manager));
-    simulation_manager->set_window(window);
-
-    simulation_manager->run();
-}
\ No newline at end of file
+    Window* window = new Window(config.width, config.height, "N-Body Simulation", simulation_manager);
+    if ( config.export_frames )
+        export_frames(window, config);
+    window->run();
+}